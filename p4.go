@@ -29,9 +29,14 @@ package p4
 
 import (
 	"bufio"
+	"context"
+	"encoding/binary"
 	"errors"
 	"fmt"
+	"io"
+	"iter"
 	"os"
+	"reflect"
 	"regexp"
 	"strconv"
 	"strings"
@@ -40,6 +45,7 @@ import (
 	"unsafe"
 )
 
+// #include "p4gometrics.h"
 // #include "p4go.h"
 // #include <stdlib.h>
 import "C"
@@ -187,12 +193,45 @@ var resolvehandler_pointer_map = &resolveHandlerPtrMap{
 	items: make(map[*C.P4GoResolveHandler]*P4ResolveHandler),
 }
 
+type streamPtrMap struct {
+	items map[*C.P4GoStream]*p4Stream
+	sync.RWMutex
+}
+
+func (c *streamPtrMap) Set(k *C.P4GoStream, v *p4Stream) {
+	c.Lock()
+	defer c.Unlock()
+
+	c.items[k] = v
+}
+
+func (c *streamPtrMap) Get(k *C.P4GoStream) *p4Stream {
+	c.RLock()
+	defer c.RUnlock()
+
+	return c.items[k]
+}
+
+func (c *streamPtrMap) Delete(k *C.P4GoStream) {
+	c.Lock()
+	defer c.Unlock()
+
+	delete(c.items, k)
+}
+
+var stream_pointer_map = &streamPtrMap{
+	items: make(map[*C.P4GoStream]*p4Stream),
+}
+
 type P4 struct {
 	handle         *C.P4GoClientApi
 	progresshandle *C.P4GoProgress
 	outputhandle   *C.P4GoHandler
+	batchhandle    *C.P4GoStream
 	ssohandle      *C.P4GoSSOHandler
 	resolvehandle  *C.P4GoResolveHandler
+	registry       *P4MetricsRegistry
+	traceDump      io.Writer
 }
 
 func New() *P4 {
@@ -210,6 +249,10 @@ func (p4 *P4) Close() {
 		handler_pointer_map.Delete(p4.outputhandle)
 		C.FreeHandler(p4.outputhandle)
 	}
+	if p4.batchhandle != nil {
+		stream_pointer_map.Delete(p4.batchhandle)
+		C.FreeStream(p4.batchhandle)
+	}
 	if p4.ssohandle != nil {
 		ssohandler_pointer_map.Delete(p4.ssohandle)
 		C.FreeSSOHandler(p4.ssohandle)
@@ -248,7 +291,14 @@ func (p4 *P4) Disconnect() (bool, error) {
 type Dictionary map[string]string
 
 func (p4 *P4) Run(cmd string, args ...string) ([]P4Result, error) {
+	run_err := p4.execute(cmd, args...)
+	return p4.fetchResults(), run_err
+}
+
+// execute runs the command, leaving its output in the C++ result set.
+func (p4 *P4) execute(cmd string, args ...string) error {
 	c_cmd := C.CString(cmd)
+	defer C.free(unsafe.Pointer(c_cmd))
 
 	argc := len(args)
 	argv := make([]*C.char, argc+1)
@@ -262,81 +312,988 @@ func (p4 *P4) Run(cmd string, args ...string) ([]P4Result, error) {
 		C.Run(p4.handle, c_cmd, C.int(argc), &argv[0], e)
 		return true
 	})
+	p4.observe(cmd)
+	run_err = p4.dumpTrace(run_err)
+	return run_err
+}
+
+// RunContext is Run, except that the command is stopped if ctx is
+// cancelled or its deadline passes before it finishes. Stopping a command
+// drops the connection, which is then reopened, as it is when a handler
+// cancels a command; the error returned includes ctx.Err().
+func (p4 *P4) RunContext(ctx context.Context, cmd string, args ...string) ([]P4Result, error) {
+	run_err := p4.withContext(ctx, func() error {
+		return p4.execute(cmd, args...)
+	})
+	return p4.fetchResults(), run_err
+}
 
-	C.free(unsafe.Pointer(c_cmd))
-
-	results := []P4Result{}
-	rcount := int(C.ResultCount(p4.handle))
-	for i := 0; i < rcount; i++ {
-		t := C.int(0)
-		r := (*C.P4GoResult)(C.malloc(C.size_t(1)))
-		if C.ResultGet(p4.handle, C.int(i), &t, &r) != 0 {
-			switch P4ResultType(int(t)) {
-			case P4RESULTTYPE_STRING:
-				s := C.ResultGetString(r)
-				results = append(results, P4Data(C.GoString(s)))
-				C.free(unsafe.Pointer(s))
-			case P4RESULTTYPE_BINARY:
-				l := C.int(0)
-				s := C.ResultGetBinary(r, &l)
-				results = append(results, P4Data(C.GoBytes(unsafe.Pointer(s), l)))
-				C.free(unsafe.Pointer(s))
-			case P4RESULTTYPE_TRACK:
-				s := C.ResultGetString(r)
-				results = append(results, P4Track(C.GoString(s)))
-				C.free(unsafe.Pointer(s))
-			case P4RESULTTYPE_DICT:
-				j := 0
-				k := (*C.char)(C.malloc(C.size_t(1)))
-				v := (*C.char)(C.malloc(C.size_t(1)))
-				d := Dictionary{}
-				for C.ResultGetKeyPair(r, C.int(j), &k, &v) != 0 {
-					j++
-					d[C.GoString(k)] = C.GoString(v)
-				}
-				C.free(unsafe.Pointer(k))
-				C.free(unsafe.Pointer(v))
-				results = append(results, d)
-			case P4RESULTTYPE_SPEC:
-				j := 0
-				k := (*C.char)(C.malloc(C.size_t(1)))
-				v := (*C.char)(C.malloc(C.size_t(1)))
-				d := Dictionary{}
-				for C.ResultGetKeyPair(r, C.int(j), &k, &v) != 0 {
-					j++
-					d[C.GoString(k)] = C.GoString(v)
-				}
-				C.free(unsafe.Pointer(k))
-				C.free(unsafe.Pointer(v))
-				results = append(results, d)
-			case P4RESULTTYPE_MESSAGE:
-				e := C.ResultGetError(r)
-				err := P4Message{}
-				err.severity = P4MessageSeverity(C.GetErrorSeverity(e))
-				ec := int(C.GetErrorCount(e))
-				err.lines = []P4MessageLine{}
-				err.msgdict = goGetMsgDict(e)
-				for j := 0; j < ec; j++ {
-					el := P4MessageLine{}
-					el.severity = P4MessageSeverity(C.GetErrorSeverityI(e, C.int(j)))
-					s := C.FmtError(e, C.int(j))
-					el.fmt = C.GoString(s)
-					C.free(unsafe.Pointer(s))
-					el.code = int(C.GetErrorCode(e, C.int(j)))
-					err.lines = append(err.lines, el)
-					err.msgdict[fmt.Sprintf("Error %d", j)] = el.fmt
-				}
-				results = append(results, err)
+// withContext runs f, which runs a command, cancelling the command from
+// another goroutine if ctx is done first. ctx.Err() is only added to the
+// error if the cancellation cut the command off: ctx may be done just
+// after a command has finished. The cancellation is cleared again before
+// returning, once it can no longer land, so that it can't leak into the
+// next command.
+func (p4 *P4) withContext(ctx context.Context, f func() error) error {
+	if err := ctx.Err(); err != nil {
+		return err
+	}
 
-			default:
-				// Unknown result?
-			}
+	C.SetCancelled(p4.handle, 0)
+	fired := make(chan struct{})
+	stop := context.AfterFunc(ctx, func() {
+		C.SetCancelled(p4.handle, 1)
+		close(fired)
+	})
+
+	err := f()
+	if !stop() {
+		<-fired
+		if C.WasCancelled(p4.handle) != 0 {
+			err = errors.Join(ctx.Err(), err)
 		}
 	}
+	C.SetCancelled(p4.handle, 0)
+	return err
+}
+
+// P4BatchCommand is one of the commands run by RunBatch
+type P4BatchCommand struct {
+	Cmd  string
+	Args []string
+}
+
+// RunBatch runs a batch of independent commands on this connection,
+// sending each without waiting for the one before to finish, and returns
+// each command's results separately, in order. On a high-latency link
+// this takes little more than one round trip per pipeline window rather
+// than one per command (see SetPipelineWindow). If the connection drops,
+// the commands that weren't sent have no results, so the slice returned
+// is short. Commands that need input, or an output handler, should be run
+// with Run. A metrics registry records each command under its own name,
+// as if it had been run alone.
+func (p4 *P4) RunBatch(cmds ...P4BatchCommand) ([][]P4Result, error) {
+	if len(cmds) == 0 {
+		return [][]P4Result{}, nil
+	}
+
+	c_cmds := make([]*C.char, len(cmds))
+	argcs := make([]C.int, len(cmds))
+	argv := make([]*C.char, 0, len(cmds)+1)
+	for i, c := range cmds {
+		c_cmds[i] = C.CString(c.Cmd)
+		defer C.free(unsafe.Pointer(c_cmds[i]))
+		argcs[i] = C.int(len(c.Args))
+		for _, arg := range c.Args {
+			carg := C.CString(arg)
+			defer C.free(unsafe.Pointer(carg))
+			argv = append(argv, carg)
+		}
+	}
+	argv = append(argv, nil)
 
+	result, run_err := handleCError(func(e *C.Error) interface{} {
+		return int(C.RunBatch(p4.handle, C.int(len(cmds)), &c_cmds[0],
+			&argcs[0], &argv[0], e))
+	})
+	sent := result.(int)
+	p4.observeBatch(cmds, sent)
+	run_err = p4.dumpTrace(run_err)
+
+	results := make([][]P4Result, sent)
+	for i := 0; i < sent; i++ {
+		l := C.int(0)
+		buf := C.BatchResultGetAll(p4.handle, C.int(i), &l)
+		d := newDecoder(p4.handle, buf, l)
+		results[i] = d.results()
+	}
 	return results, run_err
 }
 
+// fetchResults collects the whole result set of the last command in a
+// single cgo call.
+func (p4 *P4) fetchResults() []P4Result {
+	l := C.int(0)
+	buf := C.ResultGetAll(p4.handle, 0, &l)
+	return newDecoder(p4.handle, buf, l).results()
+}
+
+// p4Stream is the Go end of a P4GoStream: either a RunStream() in
+// progress or a batch handler.
+type p4Stream struct {
+	api     *C.P4GoClientApi
+	yield   func(P4Result, error) bool
+	handler P4BatchHandler
+	keys    []string // keys interned so far by the current command
+	stopped bool
+}
+
+// RunStream runs a command, yielding each result as it arrives from the
+// server. Results are neither kept by the C++ layer nor collected here, so
+// memory use stays flat however much output the command produces.
+// Breaking out of the loop cancels the command. An error running the
+// command is yielded last, with a nil result. The connection must not be
+// used for other commands from inside the loop.
+func (p4 *P4) RunStream(cmd string, args ...string) iter.Seq2[P4Result, error] {
+	return func(yield func(P4Result, error) bool) {
+		prev := C.GetStream(p4.handle)
+		s := C.NewStream()
+		st := &p4Stream{api: p4.handle, yield: yield}
+		stream_pointer_map.Set(s, st)
+		C.SetStream(p4.handle, s)
+		defer func() {
+			C.SetStream(p4.handle, prev)
+			stream_pointer_map.Delete(s)
+			C.FreeStream(s)
+		}()
+
+		run_err := p4.execute(cmd, args...)
+		if run_err != nil && !st.stopped {
+			yield(nil, run_err)
+		}
+	}
+}
+
+//export goCallStreamFunction
+func goCallStreamFunction(ctx unsafe.Pointer, buf *C.char, l C.int) C.int {
+	st := stream_pointer_map.Get((*C.P4GoStream)(ctx))
+	if st == nil || st.stopped {
+		return C.int(P4OUTPUTHANDLER_CANCEL)
+	}
+	d := newDecoder(st.api, buf, l)
+	d.keys = st.keys
+	defer func() { st.keys = d.keys }()
+	if st.handler != nil {
+		return C.int(st.handler.HandleBatch(d.results()))
+	}
+	if !d.more() {
+		return C.int(P4OUTPUTHANDLER_HANDLED)
+	}
+	n := d.header()
+	for i := 0; i < n && d.more(); i++ {
+		r := d.result()
+		if r == nil {
+			continue
+		}
+		if !st.yield(r, nil) {
+			st.stopped = true
+			return C.int(P4OUTPUTHANDLER_CANCEL)
+		}
+	}
+	return C.int(P4OUTPUTHANDLER_HANDLED)
+}
+
+type P4FilterOp int
+
+const (
+	P4FILTER_EQ     P4FilterOp = iota // Value is equal
+	P4FILTER_NE                       // Value is not equal
+	P4FILTER_PREFIX                   // Value starts with
+	P4FILTER_LT                       // Numerically less than
+	P4FILTER_LE                       // Numerically less than or equal
+	P4FILTER_GT                       // Numerically greater than
+	P4FILTER_GE                       // Numerically greater than or equal
+)
+
+// P4Predicate is a test on one key of a tagged record. A record without
+// the key fails the test.
+type P4Predicate struct {
+	Key   string
+	Op    P4FilterOp
+	Value string
+}
+
+// P4Filter is applied to tagged output in the C++ layer, so records and
+// fields that aren't wanted never reach Go. Records must pass all of the
+// Where predicates; if Fields is not empty, only those keys are kept.
+type P4Filter struct {
+	Fields []string
+	Where  []P4Predicate
+}
+
+// RunFiltered is Run with a filter applied to the command's tagged
+// output. The filter holds for this command only, so the commands run
+// by the other helpers, such as SpecIterator and RunFilelog, always see
+// their full output.
+func (p4 *P4) RunFiltered(filter *P4Filter, cmd string, args ...string) ([]P4Result, error) {
+	p4.setFilter(filter)
+	defer C.FilterClear(p4.handle)
+	return p4.Run(cmd, args...)
+}
+
+func (p4 *P4) setFilter(filter *P4Filter) {
+	C.FilterClear(p4.handle)
+	if filter == nil {
+		return
+	}
+	for _, f := range filter.Fields {
+		c_key := C.CString(f)
+		C.FilterProject(p4.handle, c_key)
+		C.free(unsafe.Pointer(c_key))
+	}
+	for _, w := range filter.Where {
+		c_key := C.CString(w.Key)
+		c_value := C.CString(w.Value)
+		C.FilterWhere(p4.handle, c_key, C.int(w.Op), c_value)
+		C.free(unsafe.Pointer(c_key))
+		C.free(unsafe.Pointer(c_value))
+	}
+}
+
+// P4Columns holds tagged output laid out by column rather than as a
+// Dictionary per row, which suits scanning very large result sets.
+type P4Columns struct {
+	Rows    int
+	Names   []string   // column names, in the order first seen
+	Other   []P4Result // any output that wasn't tagged
+	columns map[string]*P4Column
+}
+
+// P4Column is one key's values across all rows, held back to back in a
+// single buffer.
+type P4Column struct {
+	data    []byte
+	offsets []uint32
+	present []byte
+}
+
+// Column returns the named column. A column that no row has is nil, and
+// reports every row as absent.
+func (c *P4Columns) Column(name string) *P4Column {
+	return c.columns[name]
+}
+
+// Has reports whether the row has a value for this column.
+func (c *P4Column) Has(row int) bool {
+	return c != nil && c.present[row/8]&(1<<(row%8)) != 0
+}
+
+// Bytes returns the row's value without copying it; it must not be
+// modified.
+func (c *P4Column) Bytes(row int) []byte {
+	if !c.Has(row) {
+		return nil
+	}
+	return c.data[c.offsets[row]:c.offsets[row+1]]
+}
+
+func (c *P4Column) String(row int) string {
+	return string(c.Bytes(row))
+}
+
+// Int parses the row's value as a decimal integer, without allocating.
+// ok is false if the value is absent or not a number.
+func (c *P4Column) Int(row int) (v int64, ok bool) {
+	return parseInt(c.Bytes(row))
+}
+
+// parseInt parses a decimal integer without first making a string of it.
+func parseInt(b []byte) (v int64, ok bool) {
+	if len(b) > 18 {
+		// Might overflow; let strconv deal with it
+		v, err := strconv.ParseInt(string(b), 10, 64)
+		return v, err == nil
+	}
+	neg := len(b) > 0 && b[0] == '-'
+	if neg {
+		b = b[1:]
+	}
+	if len(b) == 0 {
+		return 0, false
+	}
+	for _, ch := range b {
+		if ch < '0' || ch > '9' {
+			return 0, false
+		}
+		v = v*10 + int64(ch-'0')
+	}
+	if neg {
+		v = -v
+	}
+	return v, true
+}
+
+// RunColumns runs a tagged command such as fstat, files, changes or sizes
+// and returns its output by column.
+func (p4 *P4) RunColumns(cmd string, args ...string) (*P4Columns, error) {
+	run_err := p4.execute(cmd, args...)
+	l := C.int(0)
+	buf := C.ResultGetColumns(p4.handle, &l)
+	d := newDecoder(p4.handle, buf, l)
+
+	cols := &P4Columns{columns: map[string]*P4Column{}}
+	if !d.more() {
+		return cols, run_err
+	}
+	d.readKeys()
+	cols.Rows = int(d.u32())
+	n := int(d.u32())
+	cols.Names = make([]string, 0, n)
+	for i := 0; i < n; i++ {
+		name := d.keys[d.u32()]
+		col := &P4Column{data: d.bytesCopy()}
+		col.offsets = make([]uint32, cols.Rows+1)
+		for r := range col.offsets {
+			col.offsets[r] = d.u32()
+		}
+		col.present = make([]byte, (cols.Rows+7)/8)
+		d.pos += copy(col.present, d.buf[d.pos:])
+		cols.Names = append(cols.Names, name)
+		cols.columns[name] = col
+	}
+
+	other := int(d.u32())
+	cols.Other = make([]P4Result, 0, other)
+	for i := 0; i < other && d.more(); i++ {
+		if r := d.result(); r != nil {
+			cols.Other = append(cols.Other, r)
+		}
+	}
+	return cols, run_err
+}
+
+// p4Field says which struct field a tagged value goes in
+type p4Field struct {
+	name  string
+	index int
+	kind  reflect.Kind
+}
+
+// p4Plan maps the p4 tags of a struct type to its fields. Plans are built
+// once per type and cached.
+type p4Plan struct {
+	fields map[string]*p4Field
+}
+
+var plan_cache sync.Map // reflect.Type -> *p4Plan
+
+func planFor(t reflect.Type) (*p4Plan, error) {
+	if p, ok := plan_cache.Load(t); ok {
+		return p.(*p4Plan), nil
+	}
+	plan := &p4Plan{fields: map[string]*p4Field{}}
+	for i := 0; i < t.NumField(); i++ {
+		f := t.Field(i)
+		name := f.Tag.Get("p4")
+		if name == "" || name == "-" || !f.IsExported() {
+			continue
+		}
+		switch f.Type.Kind() {
+		case reflect.String, reflect.Bool,
+			reflect.Int, reflect.Int8, reflect.Int16, reflect.Int32, reflect.Int64,
+			reflect.Uint, reflect.Uint8, reflect.Uint16, reflect.Uint32, reflect.Uint64,
+			reflect.Float32, reflect.Float64:
+		case reflect.Slice:
+			if f.Type.Elem().Kind() != reflect.String {
+				return nil, fmt.Errorf("p4: field %s has unsupported type %s", f.Name, f.Type)
+			}
+		default:
+			return nil, fmt.Errorf("p4: field %s has unsupported type %s", f.Name, f.Type)
+		}
+		plan.fields[name] = &p4Field{name: name, index: i, kind: f.Type.Kind()}
+	}
+	p, _ := plan_cache.LoadOrStore(t, plan)
+	return p.(*p4Plan), nil
+}
+
+// RunInto runs a tagged command and decodes each record straight into a
+// struct, without building a Dictionary first. out must point to a slice
+// of structs, or of pointers to structs, whose fields are tagged with the
+// keys to fill them from, e.g. `p4:"headRev"`. Numeric fields are parsed
+// as they are decoded. A bool field is true if its key is present, unless
+// the value is false or 0. Output that isn't tagged is returned as usual.
+func (p4 *P4) RunInto(cmd string, out interface{}, args ...string) ([]P4Result, error) {
+	rv := reflect.ValueOf(out)
+	if rv.Kind() != reflect.Pointer || rv.Elem().Kind() != reflect.Slice {
+		return nil, errors.New("p4: RunInto needs a pointer to a slice")
+	}
+	slice := rv.Elem()
+	et := slice.Type().Elem()
+	st := et
+	if et.Kind() == reflect.Pointer {
+		st = et.Elem()
+	}
+	if st.Kind() != reflect.Struct {
+		return nil, errors.New("p4: RunInto needs a slice of structs")
+	}
+	plan, err := planFor(st)
+	if err != nil {
+		return nil, err
+	}
+
+	run_err := p4.execute(cmd, args...)
+	l := C.int(0)
+	buf := C.ResultGetAll(p4.handle, 1, &l)
+	d := newDecoder(p4.handle, buf, l)
+	other := []P4Result{}
+	if !d.more() {
+		return other, run_err
+	}
+	n := d.header()
+
+	// Look each of this command's keys up in the plan just once
+	fields := make([]*p4Field, len(d.keys))
+	for i, k := range d.keys {
+		fields[i] = plan.fields[k]
+	}
+
+	var decode_err error
+	for i := 0; i < n && d.more(); i++ {
+		t := P4ResultType(d.buf[d.pos])
+		if t != P4RESULTTYPE_DICT && t != P4RESULTTYPE_SPEC {
+			if r := d.result(); r != nil {
+				other = append(other, r)
+			}
+			continue
+		}
+		d.pos++
+		v := reflect.New(st)
+		if err := d.into(fields, v.Elem()); err != nil && decode_err == nil {
+			decode_err = err
+		}
+		if t == P4RESULTTYPE_SPEC {
+			if err := d.intoLists(plan, v.Elem()); err != nil && decode_err == nil {
+				decode_err = err
+			}
+		}
+		if et.Kind() == reflect.Pointer {
+			slice = reflect.Append(slice, v)
+		} else {
+			slice = reflect.Append(slice, v.Elem())
+		}
+	}
+	rv.Elem().Set(slice)
+
+	if run_err != nil {
+		return other, run_err
+	}
+	return other, decode_err
+}
+
+// into decodes a dictionary into the fields of a struct. Values that
+// can't be parsed are skipped, and the first such failure is returned.
+func (d *p4Decoder) into(fields []*p4Field, v reflect.Value) error {
+	var err error
+	n := int(d.u32())
+	for i := 0; i < n; i++ {
+		f := fields[d.u32()]
+		b := d.bytes()
+		if f == nil {
+			continue
+		}
+		if !setField(v.Field(f.index), f.kind, b) && err == nil {
+			err = fmt.Errorf("p4: can't set %s from %q", f.name, b)
+		}
+	}
+	return err
+}
+
+// intoLists decodes the list fields that follow a spec's dictionary. A
+// list goes whole into a []string field with its name, or otherwise
+// value by value into fields named as the numbered keys would be.
+func (d *p4Decoder) intoLists(plan *p4Plan, v reflect.Value) error {
+	var err error
+	n := int(d.u32())
+	for i := 0; i < n; i++ {
+		name := d.keys[d.u32()]
+		count := int(d.u32())
+		if f := plan.fields[name]; f != nil && f.kind == reflect.Slice {
+			list := make([]string, count)
+			for j := range list {
+				list[j] = d.str()
+			}
+			v.Field(f.index).Set(reflect.ValueOf(list))
+			continue
+		}
+		for j := 0; j < count; j++ {
+			b := d.bytes()
+			f := plan.fields[name+strconv.Itoa(j)]
+			if f == nil {
+				continue
+			}
+			if !setField(v.Field(f.index), f.kind, b) && err == nil {
+				err = fmt.Errorf("p4: can't set %s from %q", f.name, b)
+			}
+		}
+	}
+	return err
+}
+
+func setField(fv reflect.Value, kind reflect.Kind, b []byte) bool {
+	switch kind {
+	case reflect.String:
+		fv.SetString(string(b))
+	case reflect.Bool:
+		fv.SetBool(!(string(b) == "0" || string(b) == "false"))
+	case reflect.Int, reflect.Int8, reflect.Int16, reflect.Int32, reflect.Int64:
+		n, ok := parseInt(b)
+		if !ok || fv.OverflowInt(n) {
+			return false
+		}
+		fv.SetInt(n)
+	case reflect.Uint, reflect.Uint8, reflect.Uint16, reflect.Uint32, reflect.Uint64:
+		n, ok := parseInt(b)
+		if !ok || n < 0 || fv.OverflowUint(uint64(n)) {
+			return false
+		}
+		fv.SetUint(uint64(n))
+	case reflect.Float32, reflect.Float64:
+		f, err := strconv.ParseFloat(string(b), 64)
+		if err != nil {
+			return false
+		}
+		fv.SetFloat(f)
+	case reflect.Slice:
+		fv.Set(reflect.Append(fv, reflect.ValueOf(string(b))))
+	}
+	return true
+}
+
+// RunBinaryInto runs a command such as print, appending its binary output
+// to dst instead of returning it as P4Data. The data is copied once,
+// straight from the C++ results into dst, so reusing dst from one call to
+// the next avoids allocating. Returns the extended buffer and the
+// remaining results.
+func (p4 *P4) RunBinaryInto(dst []byte, cmd string, args ...string) ([]byte, []P4Result, error) {
+	run_err := p4.execute(cmd, args...)
+	l := C.int(0)
+	buf := C.ResultGetAll(p4.handle, 0, &l)
+	d := newDecoder(p4.handle, buf, l)
+	d.sink = &dst
+	return dst, d.results(), run_err
+}
+
+// ResultArenaHighWater reports the most memory, in bytes, that a single
+// command's results have needed on the C++ side of this connection.
+func (p4 *P4) ResultArenaHighWater() int64 {
+	return int64(C.ResultArenaHighWater(p4.handle))
+}
+
+// batchArenaReserved reports the memory, in bytes, held by the result
+// arenas of the last RunBatch's commands
+func (p4 *P4) batchArenaReserved() int64 {
+	return int64(C.BatchArenaReserved(p4.handle))
+}
+
+// SetResultArenaSize sets the size of the block that results are first
+// allocated from. It is kept between commands, so sizing it from
+// ResultArenaHighWater avoids any further allocation for similar runs.
+func (p4 *P4) SetResultArenaSize(size int) {
+	C.SetResultArenaSize(p4.handle, C.int(size))
+}
+
+// P4Metrics says what running commands cost, to tell the time taken by
+// the server and the network from that taken by the binding and by
+// handlers. FirstRecord is how long the first of the output took to
+// arrive, and Total how long the run took. HandlerTime is the time spent
+// in the Crossings calls made from the C++ side into Go: to handlers,
+// streams, progress and resolves. Records counts the output received by
+// P4ResultType, including dictionaries dropped by a filter. Reconnects
+// counts the connections made again under the reconnect policy; in the
+// totals, it includes those made by Connected between runs.
+type P4Metrics struct {
+	Commands    int64
+	FirstRecord time.Duration
+	Total       time.Duration
+	HandlerTime time.Duration
+	Crossings   int64
+	Records     [P4RESULTTYPE_SPEC + 1]int64
+	TextBytes   int64
+	BinaryBytes int64
+	Reconnects  int64
+}
+
+func (p4 *P4) metrics(total bool) P4Metrics {
+	flag := 0
+	if total {
+		flag = 1
+	}
+	var m C.P4GoMetrics
+	C.GetMetrics(p4.handle, C.int(flag), &m)
+	return convertMetrics(&m)
+}
+
+// batchMetrics returns the metrics of command i of the last RunBatch
+func (p4 *P4) batchMetrics(i int) P4Metrics {
+	var m C.P4GoMetrics
+	C.BatchGetMetrics(p4.handle, C.int(i), &m)
+	return convertMetrics(&m)
+}
+
+func convertMetrics(m *C.P4GoMetrics) P4Metrics {
+	metrics := P4Metrics{
+		Commands:    int64(m.commands),
+		FirstRecord: time.Duration(m.firstRecord) * time.Microsecond,
+		Total:       time.Duration(m.total) * time.Microsecond,
+		HandlerTime: time.Duration(m.handlerTime) * time.Microsecond,
+		Crossings:   int64(m.crossings),
+		TextBytes:   int64(m.textBytes),
+		BinaryBytes: int64(m.binaryBytes),
+		Reconnects:  int64(m.reconnects),
+	}
+	for i := range metrics.Records {
+		metrics.Records[i] = int64(m.records[i])
+	}
+	return metrics
+}
+
+// Metrics returns the metrics of the last run.
+func (p4 *P4) Metrics() P4Metrics {
+	return p4.metrics(false)
+}
+
+// TotalMetrics returns the metrics of every run made with this P4, or
+// every one since ResetMetrics, added together. FirstRecord and Total are
+// sums over the runs.
+func (p4 *P4) TotalMetrics() P4Metrics {
+	return p4.metrics(true)
+}
+
+// ResetMetrics sets the totals returned by TotalMetrics back to zero.
+func (p4 *P4) ResetMetrics() {
+	C.ResetMetrics(p4.handle)
+}
+
+// P4TrackTable is what track mode reports of the commands' use of one
+// database table. The lock times are totals, apart from the Max ones.
+type P4TrackTable struct {
+	Name         string
+	PagesIn      int64
+	PagesOut     int64
+	PagesCached  int64
+	ReadLocks    int64
+	WriteLocks   int64
+	GetRows      int64
+	PosRows      int64
+	ScanRows     int64
+	PutRows      int64
+	DelRows      int64
+	ReadWait     time.Duration
+	ReadHeld     time.Duration
+	WriteWait    time.Duration
+	WriteHeld    time.Duration
+	MaxReadWait  time.Duration
+	MaxReadHeld  time.Duration
+	MaxWriteWait time.Duration
+	MaxWriteHeld time.Duration
+}
+
+// P4TrackData is the performance data that track mode (see SetTrack)
+// adds to the output of commands, parsed and added up over Commands
+// commands. RPC sizes are in megabytes, as the server reports them.
+type P4TrackData struct {
+	Commands   int
+	Lapse      time.Duration
+	RpcMsgsIn  int64
+	RpcMsgsOut int64
+	RpcSizeIn  int64
+	RpcSizeOut int64
+	RpcSend    time.Duration
+	RpcRecv    time.Duration
+	Tables     []P4TrackTable
+}
+
+// Table returns the figures for the named table, such as "db.rev", if the
+// server reported any.
+func (t P4TrackData) Table(name string) (P4TrackTable, bool) {
+	for _, tt := range t.Tables {
+		if tt.Name == name {
+			return tt, true
+		}
+	}
+	return P4TrackTable{}, false
+}
+
+func (p4 *P4) trackData(total bool) P4TrackData {
+	flag := 0
+	if total {
+		flag = 1
+	}
+	var l C.int
+	buf := C.TrackGet(p4.handle, C.int(flag), &l)
+	return decodeTrack(newDecoder(p4.handle, buf, l))
+}
+
+// batchTrackData returns the track data of command i of the last RunBatch
+func (p4 *P4) batchTrackData(i int) P4TrackData {
+	var l C.int
+	buf := C.BatchTrackGet(p4.handle, C.int(i), &l)
+	return decodeTrack(newDecoder(p4.handle, buf, l))
+}
+
+func decodeTrack(d *p4Decoder) P4TrackData {
+	ms := func() time.Duration { return time.Duration(d.i64()) * time.Millisecond }
+	t := P4TrackData{Commands: int(d.u32())}
+	t.Lapse = ms()
+	t.RpcMsgsIn = d.i64()
+	t.RpcMsgsOut = d.i64()
+	t.RpcSizeIn = d.i64()
+	t.RpcSizeOut = d.i64()
+	t.RpcSend = ms()
+	t.RpcRecv = ms()
+
+	t.Tables = make([]P4TrackTable, d.u32())
+	for i := range t.Tables {
+		tt := &t.Tables[i]
+		tt.Name = d.str()
+		tt.PagesIn, tt.PagesOut, tt.PagesCached = d.i64(), d.i64(), d.i64()
+		tt.ReadLocks, tt.WriteLocks = d.i64(), d.i64()
+		tt.GetRows, tt.PosRows, tt.ScanRows = d.i64(), d.i64(), d.i64()
+		tt.PutRows, tt.DelRows = d.i64(), d.i64()
+		tt.ReadWait, tt.ReadHeld, tt.WriteWait, tt.WriteHeld = ms(), ms(), ms(), ms()
+		tt.MaxReadWait, tt.MaxReadHeld = ms(), ms()
+		tt.MaxWriteWait, tt.MaxWriteHeld = ms(), ms()
+	}
+	return t
+}
+
+// TrackData returns the track data of the last run.
+func (p4 *P4) TrackData() P4TrackData {
+	return p4.trackData(false)
+}
+
+// TrackTotals returns the track data of every run made with this P4, or
+// every one since ResetTrackTotals, added together. Max lock times are
+// the largest of any run.
+func (p4 *P4) TrackTotals() P4TrackData {
+	return p4.trackData(true)
+}
+
+// ResetTrackTotals clears the totals returned by TrackTotals.
+func (p4 *P4) ResetTrackTotals() {
+	C.TrackReset(p4.handle)
+}
+
+// SetTrace keeps a ring of the last size events (rounded up to a power of
+// two) of this connection: commands run, output received, calls made to
+// handlers, connections made and lost, and so on. Recording an event is
+// cheap enough to leave on in production, so that Trace, DumpTrace or
+// SetTraceDumpOnError can say what led up to a problem. A size of 0
+// turns tracing off, which is the default. The ring must not be resized
+// while a command runs.
+func (p4 *P4) SetTrace(size int) {
+	C.SetTraceSize(p4.handle, C.int(size))
+}
+
+// Trace returns the events in the trace ring, oldest first. Events being
+// recorded while it is read, by a command running on another goroutine,
+// may be left out.
+func (p4 *P4) Trace() []P4TraceEvent {
+	var l C.int
+	buf := C.TraceDump(p4.handle, &l)
+	d := newDecoder(p4.handle, buf, l)
+	if !d.more() {
+		return nil
+	}
+
+	events := make([]P4TraceEvent, d.u32())
+	for i := range events {
+		e := &events[i]
+		e.Time = time.UnixMicro(d.i64())
+		e.Type = P4TraceEventType(d.u32())
+		e.Arg = int(int32(d.u32()))
+		e.Size = d.i64()
+		e.Cmd = d.str()
+	}
+	return events
+}
+
+// ClearTrace empties the trace ring.
+func (p4 *P4) ClearTrace() {
+	C.TraceClear(p4.handle)
+}
+
+// p4Decoder walks the packed buffers produced by P4GoEncoder on the C++
+// side. Integers are little-endian and strings are length-prefixed. The
+// decoder reads the C memory in place, so it must not outlive the buffer.
+type p4Decoder struct {
+	api  *C.P4GoClientApi
+	buf  []byte
+	pos  int
+	keys []string // interned dictionary keys, by ID
+	sink *[]byte  // if set, binary results are appended here
+}
+
+func newDecoder(api *C.P4GoClientApi, p *C.char, l C.int) *p4Decoder {
+	if p == nil || l == 0 {
+		return &p4Decoder{api: api}
+	}
+	return &p4Decoder{api: api, buf: unsafe.Slice((*byte)(unsafe.Pointer(p)), int(l))}
+}
+
+func (d *p4Decoder) more() bool {
+	return d.pos < len(d.buf)
+}
+
+func (d *p4Decoder) u8() byte {
+	v := d.buf[d.pos]
+	d.pos++
+	return v
+}
+
+func (d *p4Decoder) u32() uint32 {
+	v := binary.LittleEndian.Uint32(d.buf[d.pos:])
+	d.pos += 4
+	return v
+}
+
+func (d *p4Decoder) i64() int64 {
+	v := binary.LittleEndian.Uint64(d.buf[d.pos:])
+	d.pos += 8
+	return int64(v)
+}
+
+// bytes returns a view of the next string; it is only valid while the
+// underlying C buffer is.
+func (d *p4Decoder) bytes() []byte {
+	n := int(d.u32())
+	v := d.buf[d.pos : d.pos+n]
+	d.pos += n
+	return v
+}
+
+// bytesCopy returns a copy of the next string that outlives the buffer
+func (d *p4Decoder) bytesCopy() []byte {
+	return append([]byte(nil), d.bytes()...)
+}
+
+func (d *p4Decoder) str() string {
+	return string(d.bytes())
+}
+
+// binary returns a view of a binary result's data, which isn't copied into
+// the packed buffer but read from the result in place. The buffer holds
+// the data's address, as the C++ side stored it, and then its length.
+func (d *p4Decoder) binary() []byte {
+	var p *byte
+	n := copy(unsafe.Slice((*byte)(unsafe.Pointer(&p)), unsafe.Sizeof(p)), d.buf[d.pos:])
+	d.pos += n
+	l := int(d.u32())
+	if p == nil || l == 0 {
+		return nil
+	}
+	return unsafe.Slice(p, l)
+}
+
+// header reads the keys that are new in this buffer, and returns the
+// number of results that follow.
+func (d *p4Decoder) header() int {
+	d.readKeys()
+	return int(d.u32())
+}
+
+// readKeys adds the keys that are new in this buffer to the table. Each
+// key is allocated only once per command, however many records use it.
+func (d *p4Decoder) readKeys() {
+	first := int(d.u32())
+	n := int(d.u32())
+	if first < len(d.keys) {
+		d.keys = d.keys[:first]
+	}
+	for i := 0; i < n; i++ {
+		d.keys = append(d.keys, d.str())
+	}
+}
+
+// dict reads a dictionary whose keys are interned
+func (d *p4Decoder) dict() Dictionary {
+	n := int(d.u32())
+	dict := make(Dictionary, n)
+	for i := 0; i < n; i++ {
+		k := d.keys[d.u32()]
+		dict[k] = d.str()
+	}
+	return dict
+}
+
+// spec reads a spec: its single-valued fields, then its lists
+func (d *p4Decoder) spec() P4Spec {
+	spec := P4Spec{Fields: d.dict()}
+	n := int(d.u32())
+	if n == 0 {
+		return spec
+	}
+	spec.Lists = make(map[string][]string, n)
+	for i := 0; i < n; i++ {
+		name := d.keys[d.u32()]
+		list := make([]string, d.u32())
+		for j := range list {
+			list[j] = d.str()
+		}
+		spec.Lists[name] = list
+	}
+	return spec
+}
+
+// strdict reads a dictionary with its keys written out in full
+func (d *p4Decoder) strdict() Dictionary {
+	n := int(d.u32())
+	dict := make(Dictionary, n)
+	for i := 0; i < n; i++ {
+		k := d.str()
+		dict[k] = d.str()
+	}
+	return dict
+}
+
+func (d *p4Decoder) message() P4Message {
+	msg := P4Message{}
+	msg.severity = P4MessageSeverity(d.u32())
+	ec := int(d.u32())
+	msg.lines = make([]P4MessageLine, 0, ec)
+	for j := 0; j < ec; j++ {
+		el := P4MessageLine{}
+		el.severity = P4MessageSeverity(d.u32())
+		el.code = int(int32(d.u32()))
+		el.fmt = d.str()
+		msg.lines = append(msg.lines, el)
+	}
+	msg.msgdict = d.strdict()
+	for j, el := range msg.lines {
+		msg.msgdict["Error "+strconv.Itoa(j)] = el.fmt
+	}
+	return msg
+}
+
+func (d *p4Decoder) result() P4Result {
+	switch P4ResultType(d.u8()) {
+	case P4RESULTTYPE_STRING:
+		return P4Data(d.str())
+	case P4RESULTTYPE_BINARY:
+		b := d.binary()
+		if d.sink != nil {
+			*d.sink = append(*d.sink, b...)
+			return nil
+		}
+		return P4Data(b)
+	case P4RESULTTYPE_TRACK:
+		return P4Track(d.str())
+	case P4RESULTTYPE_DICT:
+		return d.dict()
+	case P4RESULTTYPE_SPEC:
+		return d.spec().Dictionary()
+	case P4RESULTTYPE_MESSAGE:
+		return d.message()
+	}
+	// Unknown result? The buffer can't be walked any further.
+	d.pos = len(d.buf)
+	return nil
+}
+
+func (d *p4Decoder) results() []P4Result {
+	if !d.more() {
+		return []P4Result{}
+	}
+	n := d.header()
+	results := make([]P4Result, 0, n)
+	for i := 0; i < n && d.more(); i++ {
+		if r := d.result(); r != nil {
+			results = append(results, r)
+		}
+	}
+	return results
+}
+
 func (p4 *P4) ApiLevel() int {
 	return int(C.GetApiLevel(p4.handle))
 }
@@ -349,6 +1306,18 @@ func (p4 *P4) Streams() bool {
 	return int(C.GetStreams(p4.handle)) != 0
 }
 
+// SetArrayConversion controls whether the list fields of specs, such as
+// a client's View, are gathered into lists on the C++ side. It is on by
+// default. Run numbers the lists out again as View0, View1 and so on;
+// FetchSpec returns them as they are.
+func (p4 *P4) SetArrayConversion(convert bool) {
+	flag := 0
+	if convert {
+		flag = 1
+	}
+	C.SetArrayConversion(p4.handle, C.int(flag))
+}
+
 func (p4 *P4) SetStreams(enableStreams bool) {
 	flag := int8(0)
 	if enableStreams {
@@ -401,6 +1370,9 @@ func (p4 *P4) Debug() int {
 	return int(C.GetDebug(p4.handle))
 }
 
+// SetDebug sets the debug level. Any level above 0 turns on the trace
+// ring, if it isn't on already (see SetTrace); above 8 the P4 API logs
+// its RPC traffic, and above 10 its SSL handshakes.
 func (p4 *P4) SetDebug(debugLevel int) {
 	C.SetDebug(p4.handle, C.int(debugLevel))
 }
@@ -632,6 +1604,52 @@ func (p4 *P4) SetMaxLockTime(maxLockTime int) {
 	C.SetMaxLockTime(p4.handle, C.int(maxLockTime))
 }
 
+// PipelineWindow is how many commands a pipelined run sends ahead before
+// waiting for their output.
+func (p4 *P4) PipelineWindow() int {
+	return int(C.GetPipelineWindow(p4.handle))
+}
+
+// SetPipelineWindow sets how many commands a pipelined run, such as
+// RunBatch or SpecStream's fetches, sends ahead before waiting for their
+// output. The default is 64.
+func (p4 *P4) SetPipelineWindow(window int) {
+	C.SetPipelineWindow(p4.handle, C.int(window))
+}
+
+// P4ReconnectPolicy says how hard a P4 tries to get back a connection
+// that the server or the network dropped. With Retries set, a command run
+// on a dropped connection connects again first, and a command marked
+// idempotent (see SetIdempotent) that loses its connection part way
+// through is run again, unless its output has already gone to a handler.
+// Each attempt waits twice as long as the one before, from Delay up to
+// MaxDelay, less a random part of up to half.
+type P4ReconnectPolicy struct {
+	Retries  int
+	Delay    time.Duration
+	MaxDelay time.Duration
+}
+
+// SetReconnectPolicy sets the reconnect policy. The zero policy, the
+// default, leaves a dropped connection for the caller to deal with.
+func (p4 *P4) SetReconnectPolicy(policy P4ReconnectPolicy) {
+	C.SetReconnect(p4.handle, C.int(policy.Retries),
+		C.int(policy.Delay.Milliseconds()), C.int(policy.MaxDelay.Milliseconds()))
+}
+
+// SetIdempotent marks cmd as safe, or not, to run again after a lost
+// connection. Common reads such as fstat, files and print are marked
+// already.
+func (p4 *P4) SetIdempotent(cmd string, idempotent bool) {
+	flag := 0
+	if idempotent {
+		flag = 1
+	}
+	c_cmd := C.CString(cmd)
+	defer C.free(unsafe.Pointer(c_cmd))
+	C.SetIdempotent(p4.handle, c_cmd, C.int(flag))
+}
+
 func (p4 *P4) SetInput(input ...string) {
 	C.ResetInput(p4.handle)
 	for _, in := range input {
@@ -691,6 +1709,12 @@ func (p4 *P4) FormatSpec(spec string, dict Dictionary) (string, error) {
 	return form, err
 }
 
+// specSetCount is how many sets of specdefs the connections in the
+// process share between them.
+func specSetCount() int {
+	return int(C.SpecRegistryCount())
+}
+
 func (p4 *P4) ServerLevel() (int, error) {
 	result, err := handleCError(func(e *C.Error) interface{} {
 		return int(C.P4ServerLevel(p4.handle, e))
@@ -736,6 +1760,66 @@ func (p4 *P4) RunFetch(spec string, args ...string) (Dictionary, error) {
 	return nil, run_err
 }
 
+// P4Spec is a form with its list fields, such as a client's View or a
+// user's Reviews, kept as lists rather than as numbered keys.
+type P4Spec struct {
+	Fields Dictionary
+	Lists  map[string][]string
+}
+
+// Dictionary returns the spec in the form Run returns it, with each list
+// numbered out into View0, View1 and so on.
+func (s P4Spec) Dictionary() Dictionary {
+	if len(s.Lists) == 0 {
+		return s.Fields
+	}
+	dict := make(Dictionary, len(s.Fields))
+	for k, v := range s.Fields {
+		dict[k] = v
+	}
+	for name, list := range s.Lists {
+		for i, v := range list {
+			dict[name+strconv.Itoa(i)] = v
+		}
+	}
+	return dict
+}
+
+// FetchSpec is RunFetch with the spec's list fields left as lists, which
+// saves numbering and parsing the keys of a view with thousands of lines.
+// It relies on array conversion, which is on unless turned off with
+// SetArrayConversion; without it the lists stay in Fields.
+func (p4 *P4) FetchSpec(spec string, args ...string) (*P4Spec, error) {
+	args = append([]string{"-o"}, args...)
+	run_err := p4.execute(spec, args...)
+	l := C.int(0)
+	buf := C.ResultGetAll(p4.handle, 1, &l)
+	d := newDecoder(p4.handle, buf, l)
+	if !d.more() {
+		return nil, run_err
+	}
+	n := d.header()
+
+	for i := 0; i < n && d.more(); i++ {
+		switch P4ResultType(d.buf[d.pos]) {
+		case P4RESULTTYPE_SPEC:
+			d.pos++
+			s := d.spec()
+			return &s, run_err
+		case P4RESULTTYPE_DICT:
+			d.pos++
+			return &P4Spec{Fields: d.dict()}, run_err
+		}
+		if msg, ok := d.result().(P4Message); ok {
+			if msg.Severity() == P4MESSAGE_FAILED || msg.Severity() == P4MESSAGE_FATAL {
+				return nil, errors.Join(run_err, &msg)
+			}
+		}
+	}
+
+	return nil, run_err
+}
+
 // Generic Save methods
 func (p4 *P4) RunSave(spec string, specdict Dictionary, args ...string) (*P4Message, error) {
 	formattedSpec, err := p4.FormatSpec(spec, specdict)
@@ -887,51 +1971,123 @@ func (p4 *P4) RunDelete(spec string, args ...string) (*P4Message, error) {
 	return nil, run_err
 }
 
+// SpecIterator fetches every spec that the list command spec (such as
+// "clients") lists with args. The specs come back in the order they were
+// listed; those that couldn't be fetched are left out, and named in the
+// error. SpecStream does the same without holding every spec at once.
 func (p4 *P4) SpecIterator(spec string, args ...string) ([]Dictionary, error) {
-	// Mapping for specs Iterator
-	specTypes := map[string][2]string{
-		"clients":  {"client", "client"},
-		"labels":   {"label", "label"},
-		"branches": {"branch", "branch"},
-		"changes":  {"change", "change"},
-		"streams":  {"stream", "Stream"},
-		"jobs":     {"job", "Job"},
-		"users":    {"user", "User"},
-		"groups":   {"group", "group"},
-		"depots":   {"depot", "name"},
-		"servers":  {"server", "ServerID"},
-		"ldaps":    {"ldap", "Name"},
-		"remotes":  {"remote", "RemoteID"},
-		"repos":    {"repo", "Repo"},
-	}
 	var results []Dictionary
-
-	// Check if method exists in specTypes
-	if _, exists := specTypes[spec]; !exists {
-		return nil, fmt.Errorf("Not a P4 Spectype: %s", spec)
+	var errs []error
+	for d, err := range p4.SpecStream(spec, args...) {
+		if d != nil {
+			results = append(results, d)
+		}
+		if err != nil {
+			errs = append(errs, err)
+		}
 	}
+	return results, errors.Join(errs...)
+}
+
+// Mapping for specs Iterator: the spec each list command lists, and the
+// key its names are under
+var specTypes = map[string][2]string{
+	"clients":  {"client", "client"},
+	"labels":   {"label", "label"},
+	"branches": {"branch", "branch"},
+	"changes":  {"change", "change"},
+	"streams":  {"stream", "Stream"},
+	"jobs":     {"job", "Job"},
+	"users":    {"user", "User"},
+	"groups":   {"group", "group"},
+	"depots":   {"depot", "name"},
+	"servers":  {"server", "ServerID"},
+	"ldaps":    {"ldap", "Name"},
+	"remotes":  {"remote", "RemoteID"},
+	"repos":    {"repo", "Repo"},
+}
+
+// SpecStream runs the list command spec with args and yields each spec it
+// lists, in order, as it is fetched. The fetches are pipelined a window
+// at a time (see SetPipelineWindow), so only that many specs are held at
+// once. There is one yield for each name listed; if the fetch failed or
+// warned, the error names the spec, and the spec is nil unless the
+// server sent one regardless. An error running the list command is
+// yielded last, with a nil spec. Breaking out of the loop stops the
+// fetches.
+func (p4 *P4) SpecStream(spec string, args ...string) iter.Seq2[Dictionary, error] {
+	return func(yield func(Dictionary, error) bool) {
+		// Check if method exists in specTypes
+		if _, exists := specTypes[spec]; !exists {
+			yield(nil, fmt.Errorf("Not a P4 Spectype: %s", spec))
+			return
+		}
 
-	specs, run_err := p4.Run(spec, args...)
+		specs, run_err := p4.Run(spec, args...)
 
-	c := specTypes[spec][0]
-	k := specTypes[spec][1]
+		c := specTypes[spec][0]
+		k := specTypes[spec][1]
 
-	for _, spec := range specs {
-		if _, ok := spec.(Dictionary); !ok {
-			return nil, errors.Join(run_err, fmt.Errorf("No such spec: %s", spec))
+		names := make([]string, 0, len(specs))
+		for _, spec := range specs {
+			if _, ok := spec.(Dictionary); !ok {
+				yield(nil, errors.Join(run_err, fmt.Errorf("No such spec: %s", spec)))
+				return
+			}
+			names = append(names, spec.(Dictionary)[k])
 		}
-		specDict := spec.(Dictionary)
-		if k == "" {
-			res, _ := p4.Run(c, "-o")
-			results = append(results, (res[0]).(Dictionary))
-		} else {
-			res, _ := p4.Run(c, "-o", specDict[k])
-			results = append(results, (res[0]).(Dictionary))
+
+		window := p4.PipelineWindow()
+		for start := 0; start < len(names); start += window {
+			chunk := names[start:min(start+window, len(names))]
+			cmds := make([]P4BatchCommand, len(chunk))
+			for i, name := range chunk {
+				cmds[i] = P4BatchCommand{Cmd: c, Args: []string{"-o", name}}
+			}
+
+			fetched, fetch_err := p4.RunBatch(cmds...)
+			for i, name := range chunk {
+				var d Dictionary
+				var err error
+				if i < len(fetched) {
+					d, err = specResult(fetched[i])
+				} else {
+					err = errors.Join(fetch_err, errors.New("not fetched"))
+				}
+				if err != nil {
+					err = fmt.Errorf("%s %s: %w", c, name, err)
+				}
+				if !yield(d, err) {
+					return
+				}
+			}
 		}
 
+		if run_err != nil {
+			yield(nil, run_err)
+		}
 	}
-	return results, run_err
+}
 
+// specResult picks out the spec, and any failure or warning, from the
+// results of fetching one spec.
+func specResult(results []P4Result) (Dictionary, error) {
+	var d Dictionary
+	var errs []error
+	for _, r := range results {
+		switch v := r.(type) {
+		case Dictionary:
+			d = v
+		case P4Message:
+			if v.Severity() >= P4MESSAGE_WARN {
+				errs = append(errs, &v)
+			}
+		}
+	}
+	if d == nil && errs == nil {
+		errs = append(errs, errors.New("no spec returned"))
+	}
+	return d, errors.Join(errs...)
 }
 
 func (p4 *P4) RunPassword(old string, new string) (*P4Message, error) {
@@ -1021,34 +2177,76 @@ func (p4 *P4) RunTickets() ([]map[string]string, error) {
 }
 
 // RunFilelog processes raw filelog data and returns a slice of DepotFiles.
+// The revisions and integrations are pulled out of the tagged output by
+// the C++ layer, and arrive here already grouped.
 func (p4 *P4) RunFilelog(args ...string) ([]*P4DepotFile, error) {
 	var result []*P4DepotFile
 
-	raw, run_err := p4.Run("filelog", args...)
-
-	for _, h := range raw {
-		var df *P4DepotFile
-		var err error
+	run_err := p4.execute("filelog", args...)
+	l := C.int(0)
+	buf := C.ResultGetFilelog(p4.handle, &l)
+	d := newDecoder(p4.handle, buf, l)
+	if !d.more() {
+		return result, run_err
+	}
 
-		if hDict, ok := h.(Dictionary); ok {
-			hMap := make(map[string]interface{})
-			for key, value := range hDict {
-				hMap[key] = value
-			}
-			df, err = ProcessFilelog(hMap)
-			if err != nil {
-				return nil, errors.Join(run_err, err)
-			}
-		} else {
+	n := int(d.u32())
+	for i := 0; i < n; i++ {
+		if P4ResultType(d.u8()) != P4RESULTTYPE_DICT {
 			return nil, errors.Join(run_err, errors.New("unexpected filelog data type"))
 		}
-
+		df, err := d.filelog()
+		if err != nil {
+			return nil, errors.Join(run_err, err)
+		}
 		result = append(result, df)
 	}
 
 	return result, run_err
 }
 
+// filelog reads a depot file packed by P4GoFilelog
+func (d *p4Decoder) filelog() (*P4DepotFile, error) {
+	hasName := d.u8() != 0
+	name := d.str()
+	if !hasName {
+		return nil, errors.New("not a filelog object: missing depotFile")
+	}
+
+	df := NewDepotFile(name)
+	nrevs := int(d.u32())
+	df.Revisions = make([]*P4Revision, 0, nrevs)
+	for n := 0; n < nrevs; n++ {
+		r := df.NewRevision()
+		rev, _ := parseInt(d.bytes())
+		r.Rev = int(rev)
+		change, _ := parseInt(d.bytes())
+		r.Change = int(change)
+		r.Action = d.str()
+		r.Type = d.str()
+		t, _ := parseInt(d.bytes())
+		r.Time = time.Unix(t, 0)
+		r.User = d.str()
+		r.Client = d.str()
+		r.Desc = d.str()
+		r.Digest = d.str()
+		r.FileSize = d.str()
+
+		nints := int(d.u32())
+		if nints > 0 {
+			r.Integrations = make([]P4Integration, 0, nints)
+		}
+		for m := 0; m < nints; m++ {
+			how := d.str()
+			file := d.str()
+			srev := parseRevision(d.str())
+			erev := parseRevision(d.str())
+			r.AddIntegration(how, file, srev, erev)
+		}
+	}
+	return df, nil
+}
+
 func (Dictionary) ResultType() P4ResultType { return P4RESULTTYPE_DICT }
 
 type P4MessageSeverity int
@@ -1298,6 +2496,33 @@ func (p4 *P4) SetHandler(handler P4OutputHandler) {
 	}
 }
 
+// P4BatchHandler receives command output a batch at a time, at the cost of
+// one call across from C++ per batch instead of one per record and key.
+// Returning P4OUTPUTHANDLER_REPORT keeps the batch for Run to return.
+type P4BatchHandler interface {
+	HandleBatch(results []P4Result) P4OutputHandlerResult
+}
+
+// SetBatchHandler installs a handler that is passed results once records
+// of them have built up, once they take bytes of storage, or once interval
+// has passed since the last batch, whichever comes first. Zero disables a
+// limit; any remainder is passed on at the end of the command. A nil
+// handler removes it.
+func (p4 *P4) SetBatchHandler(handler P4BatchHandler, records int, bytes int, interval time.Duration) {
+	if p4.batchhandle != nil {
+		C.SetStream(p4.handle, nil)
+		stream_pointer_map.Delete(p4.batchhandle)
+		C.FreeStream(p4.batchhandle)
+		p4.batchhandle = nil
+	}
+	if handler != nil {
+		p4.batchhandle = C.NewStream()
+		C.SetStreamBatch(p4.batchhandle, C.int(records), C.int(bytes), C.int(interval.Milliseconds()))
+		stream_pointer_map.Set(p4.batchhandle, &p4Stream{api: p4.handle, handler: handler})
+		C.SetStream(p4.handle, p4.batchhandle)
+	}
+}
+
 //export goCallHandleBinaryFunction
 func goCallHandleBinaryFunction(ctx unsafe.Pointer, t *C.char, l C.int) C.int {
 	handler := handler_pointer_map.Get((*C.P4GoHandler)(ctx))
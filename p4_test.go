@@ -28,6 +28,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 package p4
 
 import (
+	"context"
+	"errors"
 	"fmt"
 	"log"
 	"os"
@@ -455,6 +457,176 @@ func (s *PerforceTestSuite) TestInfo() {
 	s.p4api.Close()
 }
 
+func (s *PerforceTestSuite) TestMetrics() {
+	assert.NotNil(s.T(), s.p4api, "Failed to create Perforce client")
+
+	_, err := s.p4api.Connect()
+	assert.Nil(s.T(), err, "Failed to connect to Perforce server")
+	s.p4api.ResetMetrics()
+
+	info, err := s.p4api.Run("info")
+	assert.Nil(s.T(), err, "Info command failed")
+	m := s.p4api.Metrics()
+	assert.Equal(s.T(), int64(1), m.Commands)
+	assert.Equal(s.T(), int64(len(info)), m.Records[P4RESULTTYPE_DICT])
+	assert.True(s.T(), m.Total > 0, "Run should have taken some time")
+	assert.True(s.T(), m.FirstRecord <= m.Total, "First record after the end")
+	assert.Equal(s.T(), int64(0), m.Crossings, "No handler, so no callbacks")
+
+	_, err = s.p4api.Run("info")
+	assert.Nil(s.T(), err, "Info command failed")
+	total := s.p4api.TotalMetrics()
+	assert.Equal(s.T(), int64(2), total.Commands)
+	assert.Equal(s.T(), 2*m.Records[P4RESULTTYPE_DICT], total.Records[P4RESULTTYPE_DICT])
+
+	s.p4api.ResetMetrics()
+	assert.Equal(s.T(), P4Metrics{}, s.p4api.TotalMetrics())
+
+	ret, err := s.p4api.Disconnect()
+	assert.True(s.T(), ret, "should disconnect")
+	assert.Nil(s.T(), err, "should disconnect")
+	s.p4api.Close()
+}
+
+var errWriteFailed = errors.New("write failed")
+
+// failingWriter fails every write, for testing trace dumps
+type failingWriter struct{}
+
+func (failingWriter) Write(p []byte) (int, error) { return 0, errWriteFailed }
+
+func (s *PerforceTestSuite) TestTrace() {
+	assert.NotNil(s.T(), s.p4api, "Failed to create Perforce client")
+	assert.Empty(s.T(), s.p4api.Trace(), "Tracing should be off by default")
+
+	s.p4api.SetTrace(16)
+	_, err := s.p4api.Connect()
+	assert.Nil(s.T(), err, "Failed to connect to Perforce server")
+
+	_, err = s.p4api.Run("info")
+	assert.Nil(s.T(), err, "Info command failed")
+	events := s.p4api.Trace()
+	types := make([]P4TraceEventType, len(events))
+	for i, e := range events {
+		types[i] = e.Type
+	}
+	assert.Equal(s.T(), []P4TraceEventType{P4TRACE_CONNECT, P4TRACE_RUN, P4TRACE_STAT, P4TRACE_END}, types)
+	assert.Equal(s.T(), 1, events[0].Arg, "Connect should have succeeded")
+	assert.Equal(s.T(), "info", events[1].Cmd)
+	assert.Equal(s.T(), int64(1), events[3].Size)
+	assert.False(s.T(), events[3].Time.Before(events[1].Time))
+
+	// The ring keeps only the last 16 events
+	for range 10 {
+		_, err = s.p4api.Run("info")
+		assert.Nil(s.T(), err, "Info command failed")
+	}
+	events = s.p4api.Trace()
+	assert.Len(s.T(), events, 16)
+	assert.Equal(s.T(), P4TRACE_END, events[15].Type)
+
+	var dump strings.Builder
+	s.p4api.SetTraceDumpOnError(&dump)
+	_, err = s.p4api.Run("info")
+	assert.Nil(s.T(), err, "Info command failed")
+	assert.Empty(s.T(), dump.String(), "Nothing failed, so no dump")
+
+	_, err = s.p4api.Run("nosuchcommand")
+	assert.NotNil(s.T(), err, "Unknown command should fail")
+	assert.Contains(s.T(), dump.String(), "nosuchcommand run")
+	assert.Empty(s.T(), s.p4api.Trace(), "Ring should be cleared once dumped")
+
+	// A dump that can't be written is reported, and the ring kept
+	s.p4api.SetTraceDumpOnError(failingWriter{})
+	_, err = s.p4api.Run("nosuchcommand")
+	assert.ErrorIs(s.T(), err, errWriteFailed, "Failed dump not reported")
+	assert.NotEmpty(s.T(), s.p4api.Trace(), "Ring cleared without being dumped")
+
+	s.p4api.SetTraceDumpOnError(nil)
+	s.p4api.SetTrace(0)
+	ret, err := s.p4api.Disconnect()
+	assert.True(s.T(), ret, "should disconnect")
+	assert.Nil(s.T(), err, "should disconnect")
+	s.p4api.Close()
+}
+
+func (s *PerforceTestSuite) TestMetricsRegistry() {
+	assert.NotNil(s.T(), s.p4api, "Failed to create Perforce client")
+
+	_, err := s.p4api.Connect()
+	assert.Nil(s.T(), err, "Failed to connect to Perforce server")
+
+	registry := NewMetricsRegistry()
+	s.p4api.SetMetricsRegistry(registry)
+	for range 2 {
+		_, err = s.p4api.Run("info")
+		assert.Nil(s.T(), err, "Info command failed")
+	}
+	s.p4api.SetMetricsRegistry(nil)
+
+	var b strings.Builder
+	n, err := registry.WriteTo(&b)
+	assert.Nil(s.T(), err, "Failed to write metrics")
+	out := b.String()
+	assert.Equal(s.T(), int64(len(out)), n)
+	assert.Contains(s.T(), out, "# TYPE p4go_command_duration_seconds histogram\n")
+	assert.Contains(s.T(), out, `p4go_command_duration_seconds_count{cmd="info"} 2`)
+	assert.Contains(s.T(), out, `p4go_command_duration_seconds_bucket{cmd="info",le="+Inf"} 2`)
+	assert.Contains(s.T(), out, `p4go_command_records_total{cmd="info",type="dict"} 2`)
+	assert.True(s.T(), strings.HasSuffix(out, "# EOF\n"), "Missing EOF")
+
+	// Each command of a batch is recorded under its own name
+	registry = NewMetricsRegistry()
+	s.p4api.SetMetricsRegistry(registry)
+	_, err = s.p4api.RunBatch(
+		P4BatchCommand{Cmd: "info"},
+		P4BatchCommand{Cmd: "info"},
+		P4BatchCommand{Cmd: "depots"},
+	)
+	assert.Nil(s.T(), err, "Batch failed")
+	s.p4api.SetMetricsRegistry(nil)
+
+	b.Reset()
+	_, err = registry.WriteTo(&b)
+	assert.Nil(s.T(), err, "Failed to write metrics")
+	out = b.String()
+	assert.Contains(s.T(), out, `p4go_command_duration_seconds_count{cmd="info"} 2`)
+	assert.Contains(s.T(), out, `p4go_command_records_total{cmd="info",type="dict"} 2`)
+	assert.Contains(s.T(), out, `p4go_command_duration_seconds_count{cmd="depots"} 1`)
+	assert.Contains(s.T(), out, `p4go_command_records_total{cmd="depots",type="dict"} 1`)
+	assert.NotContains(s.T(), out, `cmd="batch"`, "Batch recorded as one command")
+
+	ret, err := s.p4api.Disconnect()
+	assert.True(s.T(), ret, "should disconnect")
+	assert.Nil(s.T(), err, "should disconnect")
+	s.p4api.Close()
+}
+
+func (s *PerforceTestSuite) TestResultArena() {
+	assert.NotNil(s.T(), s.p4api, "Failed to create Perforce client")
+
+	info, err := s.p4api.Run("info")
+	assert.Nil(s.T(), err, "Info command failed")
+	hw := s.p4api.ResultArenaHighWater()
+	assert.True(s.T(), hw > 0, "Results should have used the arena")
+
+	// Results must come back the same however the arena is sized
+	s.p4api.SetResultArenaSize(1)
+	again, err := s.p4api.Run("info")
+	assert.Nil(s.T(), err, "Info command failed")
+	assert.Equal(s.T(), len(info), len(again))
+	assert.Equal(s.T(), info[0].(Dictionary)["serverRoot"], again[0].(Dictionary)["serverRoot"])
+
+	s.p4api.SetResultArenaSize(int(hw))
+	_, err = s.p4api.Run("info")
+	assert.Nil(s.T(), err, "Info command failed")
+
+	ret, err := s.p4api.Disconnect()
+	assert.True(s.T(), ret, "should disconnect")
+	assert.Nil(s.T(), err, "should disconnect")
+	s.p4api.Close()
+}
+
 func (s *PerforceTestSuite) TestEnvironment() {
 	assert.NotNil(s.T(), s.p4api, "Failed to create Perforce client")
 	setSupported := !(getOS() == "windows" || getOS() == "darwin" || getOS() == "mingw")
@@ -701,6 +873,19 @@ func (s *PerforceTestSuite) TestFiles() {
 	filelog, _ := s.p4api.RunFilelog("test_files/...")
 	require.Len(s.T(), filelog, 3)
 
+	// The native decoder must agree with ProcessFilelog
+	raw, _ := s.p4api.Run("filelog", "test_files/...")
+	require.Len(s.T(), raw, 3)
+	for i, r := range raw {
+		h := map[string]interface{}{}
+		for k, v := range r.(Dictionary) {
+			h[k] = v
+		}
+		df, err := ProcessFilelog(h)
+		require.NoError(s.T(), err, "Failed to process filelog")
+		assert.Equal(s.T(), df, filelog[i], "Filelog decoders disagree")
+	}
+
 	// Test DepotFile, Revisions, and Integrations
 	for _, df := range filelog {
 		// Test DepotFile attributes
@@ -1477,6 +1662,17 @@ GconnMirrorHideFetchUrl:	false`
 	spec, _ = s.p4api.RunFetch("job", "job000001")
 	assert.IsTypef(s.T(), Dictionary{}, spec, "Expected type %T, but got %T", Dictionary{}, spec)
 
+	// Tagged specs are converted without going through a form, so check
+	// they still match what parsing the untagged form gives. The job has
+	// a select (Status) and an optional (Field1) field, the client a
+	// wordlist (Options) and a list (View).
+	s.compareSpecForm("job", "job000001")
+	clientSpec, _ := s.p4api.RunFetch("client")
+	clientSpec["Options"] = "allwrite noclobber nocompress unlocked nomodtime normdir"
+	_, err = s.p4api.RunSave("client", clientSpec)
+	s.Require().NoError(err, "Failed to save client")
+	s.compareSpecForm("client")
+
 	// // Check if the 'Field1' key exists in the spec map
 	// _, exists := spec["Field0"]
 	// assert.True(s.T(), exists, "spec does not contain the key 'Field1'")
@@ -1811,6 +2007,595 @@ func (s *PerforceTestSuite) TestOutput() {
 
 }
 
+func (s *PerforceTestSuite) TestPrintBinary() {
+	assert.NotNil(s.T(), s.p4api, "Failed to create Perforce client")
+
+	_, err := s.p4api.Connect()
+	assert.Nil(s.T(), err, "Failed to connect to Perforce server")
+
+	s.createClient()
+
+	// Embedded NULs must survive the trip
+	content := []byte("binary\x00data\x00\x01\x02\xff")
+	err = os.WriteFile("bin.dat", content, 0644)
+	assert.Nil(s.T(), err, "Failed to create file")
+	_, _ = s.p4api.Run("add", "-t", "binary", "bin.dat")
+	_, err = s.p4api.RunSubmit("-d", "binary file")
+	assert.Nil(s.T(), err, "Failed to submit binary file")
+
+	res, err := s.p4api.Run("print", "-q", "bin.dat")
+	assert.Nil(s.T(), err, "Failed to print binary file")
+	var data []byte
+	for _, r := range res {
+		if d, ok := r.(P4Data); ok {
+			data = append(data, d...)
+		}
+	}
+	assert.Equal(s.T(), content, data, "Binary data was mangled")
+
+	buf := make([]byte, 0, 64)
+	buf, res, err = s.p4api.RunBinaryInto(buf[:0], "print", "-q", "bin.dat")
+	assert.Nil(s.T(), err, "Failed to print binary file")
+	assert.Equal(s.T(), content, buf, "Binary data was mangled")
+	for _, r := range res {
+		assert.NotEqual(s.T(), P4RESULTTYPE_STRING, r.ResultType(), "Binary data should not be in the results")
+	}
+
+	ret, err := s.p4api.Disconnect()
+	assert.True(s.T(), ret, "should disconnect")
+	assert.Nil(s.T(), err, "should disconnect")
+	s.p4api.Close()
+}
+
+func (s *PerforceTestSuite) TestRunStream() {
+	assert.NotNil(s.T(), s.p4api, "Failed to create Perforce client")
+
+	_, err := s.p4api.Connect()
+	assert.Nil(s.T(), err, "Failed to connect to Perforce server")
+
+	s.createClient()
+
+	for _, fn := range []string{"foo", "bar", "baz"} {
+		err := os.WriteFile(fn+".txt", []byte("Test\n"), 0644)
+		assert.Nil(s.T(), err, "Failed to create file")
+		_, _ = s.p4api.Run("add", fn+".txt")
+	}
+	_, err = s.p4api.RunSubmit("-d", "test")
+	assert.Nil(s.T(), err, "Failed to submit test")
+
+	expected, err := s.p4api.Run("files", "//...")
+	assert.Nil(s.T(), err, "Failed to run files")
+
+	streamed := []P4Result{}
+	for r, err := range s.p4api.RunStream("files", "//...") {
+		assert.Nil(s.T(), err, "Failed to stream files")
+		streamed = append(streamed, r)
+	}
+	assert.Equal(s.T(), expected, streamed, "Streamed results differ from Run")
+
+	// Stopping early cancels the command, but the connection stays usable
+	count := 0
+	for range s.p4api.RunStream("files", "//...") {
+		count++
+		break
+	}
+	assert.Equal(s.T(), 1, count, "Stream should have stopped")
+
+	info, err := s.p4api.Run("info")
+	assert.Nil(s.T(), err, "Info command failed after cancel")
+	assert.True(s.T(), len(info) > 0, "Info command failed after cancel")
+
+	ret, err := s.p4api.Disconnect()
+	assert.True(s.T(), ret, "should disconnect")
+	assert.Nil(s.T(), err, "should disconnect")
+	s.p4api.Close()
+}
+
+type countingBatchHandler struct {
+	batches []int
+	last    []P4Result
+	result  P4OutputHandlerResult
+}
+
+func (h *countingBatchHandler) HandleBatch(results []P4Result) P4OutputHandlerResult {
+	h.batches = append(h.batches, len(results))
+	h.last = results
+	return h.result
+}
+
+func (s *PerforceTestSuite) TestBatchHandler() {
+	assert.NotNil(s.T(), s.p4api, "Failed to create Perforce client")
+
+	_, err := s.p4api.Connect()
+	assert.Nil(s.T(), err, "Failed to connect to Perforce server")
+
+	s.createClient()
+
+	for _, fn := range []string{"foo", "bar", "baz"} {
+		err := os.WriteFile(fn+".txt", []byte("Test\n"), 0644)
+		assert.Nil(s.T(), err, "Failed to create file")
+		_, _ = s.p4api.Run("add", fn+".txt")
+	}
+	_, err = s.p4api.RunSubmit("-d", "test")
+	assert.Nil(s.T(), err, "Failed to submit test")
+
+	h := &countingBatchHandler{result: P4OUTPUTHANDLER_HANDLED}
+	s.p4api.SetBatchHandler(h, 2, 0, 0)
+	res, err := s.p4api.Run("files", "//...")
+	assert.Nil(s.T(), err, "Failed to run files")
+	assert.Equal(s.T(), []int{2, 1}, h.batches, "Unexpected batch sizes")
+	assert.Equal(s.T(), 0, len(res), "Handled batches should not be returned")
+
+	h = &countingBatchHandler{result: P4OUTPUTHANDLER_REPORT}
+	s.p4api.SetBatchHandler(h, 0, 0, 0)
+	res, err = s.p4api.Run("files", "//...")
+	assert.Nil(s.T(), err, "Failed to run files")
+	assert.Equal(s.T(), []int{3}, h.batches, "Expected a single batch")
+	assert.Equal(s.T(), 3, len(res), "Reported batches should be returned")
+
+	// Interned keys start afresh with each command
+	_, err = s.p4api.Run("info")
+	assert.Nil(s.T(), err, "Info command failed")
+	assert.Equal(s.T(), s.serverRoot, h.last[0].(Dictionary)["serverRoot"], "Keys should not carry over between commands")
+
+	s.p4api.SetBatchHandler(nil, 0, 0, 0)
+
+	ret, err := s.p4api.Disconnect()
+	assert.True(s.T(), ret, "should disconnect")
+	assert.Nil(s.T(), err, "should disconnect")
+	s.p4api.Close()
+}
+
+func (s *PerforceTestSuite) TestRunColumns() {
+	assert.NotNil(s.T(), s.p4api, "Failed to create Perforce client")
+
+	_, err := s.p4api.Connect()
+	assert.Nil(s.T(), err, "Failed to connect to Perforce server")
+
+	s.createClient()
+
+	for _, fn := range []string{"foo", "bar", "baz"} {
+		err := os.WriteFile(fn+".txt", []byte("Test\n"), 0644)
+		assert.Nil(s.T(), err, "Failed to create file")
+		_, _ = s.p4api.Run("add", fn+".txt")
+	}
+	_, err = s.p4api.RunSubmit("-d", "test")
+	assert.Nil(s.T(), err, "Failed to submit test")
+
+	expected, err := s.p4api.Run("fstat", "//...")
+	assert.Nil(s.T(), err, "Failed to run fstat")
+
+	cols, err := s.p4api.RunColumns("fstat", "//...")
+	assert.Nil(s.T(), err, "Failed to run fstat")
+	assert.Equal(s.T(), len(expected), cols.Rows, "Wrong number of rows")
+	assert.Equal(s.T(), 0, len(cols.Other), "Unexpected untagged output")
+
+	for r, res := range expected {
+		dict := res.(Dictionary)
+		for _, name := range cols.Names {
+			v, ok := dict[name]
+			col := cols.Column(name)
+			assert.Equal(s.T(), ok, col.Has(r), "Presence of "+name)
+			assert.Equal(s.T(), v, col.String(r), "Value of "+name)
+		}
+		rev, ok := cols.Column("headRev").Int(r)
+		assert.True(s.T(), ok, "headRev should be numeric")
+		assert.Equal(s.T(), int64(1), rev, "Wrong headRev")
+	}
+	assert.False(s.T(), cols.Column("noSuchKey").Has(0), "Missing columns have no values")
+
+	ret, err := s.p4api.Disconnect()
+	assert.True(s.T(), ret, "should disconnect")
+	assert.Nil(s.T(), err, "should disconnect")
+	s.p4api.Close()
+}
+
+type fstatRecord struct {
+	DepotFile  string `p4:"depotFile"`
+	HeadAction string `p4:"headAction"`
+	HeadRev    int    `p4:"headRev"`
+	HeadChange int64  `p4:"headChange"`
+	IsMapped   bool   `p4:"isMapped"`
+	Shelved    bool   `p4:"shelved"`
+	Ignored    string
+}
+
+func (s *PerforceTestSuite) TestRunInto() {
+	assert.NotNil(s.T(), s.p4api, "Failed to create Perforce client")
+
+	_, err := s.p4api.Connect()
+	assert.Nil(s.T(), err, "Failed to connect to Perforce server")
+
+	s.createClient()
+
+	for _, fn := range []string{"foo", "bar", "baz"} {
+		err := os.WriteFile(fn+".txt", []byte("Test\n"), 0644)
+		assert.Nil(s.T(), err, "Failed to create file")
+		_, _ = s.p4api.Run("add", fn+".txt")
+	}
+	_, err = s.p4api.RunSubmit("-d", "test")
+	assert.Nil(s.T(), err, "Failed to submit test")
+
+	expected, err := s.p4api.Run("fstat", "//...")
+	assert.Nil(s.T(), err, "Failed to run fstat")
+
+	var recs []fstatRecord
+	other, err := s.p4api.RunInto("fstat", &recs, "//...")
+	assert.Nil(s.T(), err, "Failed to run fstat")
+	assert.Equal(s.T(), 0, len(other), "Unexpected untagged output")
+	assert.Equal(s.T(), len(expected), len(recs), "Wrong number of records")
+	for i, rec := range recs {
+		dict := expected[i].(Dictionary)
+		assert.Equal(s.T(), dict["depotFile"], rec.DepotFile)
+		assert.Equal(s.T(), "add", rec.HeadAction)
+		assert.Equal(s.T(), 1, rec.HeadRev)
+		assert.Equal(s.T(), dict["headChange"], strconv.FormatInt(rec.HeadChange, 10))
+		assert.True(s.T(), rec.IsMapped, "isMapped should be set")
+		assert.False(s.T(), rec.Shelved, "shelved should not be set")
+		assert.Equal(s.T(), "", rec.Ignored)
+	}
+
+	var ptrs []*fstatRecord
+	_, err = s.p4api.RunInto("fstat", &ptrs, "//...")
+	assert.Nil(s.T(), err, "Failed to run fstat")
+	assert.Equal(s.T(), len(recs), len(ptrs))
+
+	_, err = s.p4api.RunInto("fstat", recs, "//...")
+	assert.NotNil(s.T(), err, "RunInto should need a pointer")
+
+	ret, err := s.p4api.Disconnect()
+	assert.True(s.T(), ret, "should disconnect")
+	assert.Nil(s.T(), err, "should disconnect")
+	s.p4api.Close()
+}
+
+func (s *PerforceTestSuite) TestFetchSpec() {
+	assert.NotNil(s.T(), s.p4api, "Failed to create Perforce client")
+
+	_, err := s.p4api.Connect()
+	assert.Nil(s.T(), err, "Failed to connect to Perforce server")
+
+	s.createClient()
+
+	client, err := s.p4api.RunFetch("client")
+	assert.Nil(s.T(), err, "Failed to fetch client")
+
+	spec, err := s.p4api.FetchSpec("client")
+	assert.Nil(s.T(), err, "Failed to fetch client spec")
+	assert.NotNil(s.T(), spec, "No client spec")
+	assert.Equal(s.T(), client["View0"], spec.Lists["View"][0], "View not grouped")
+	assert.Equal(s.T(), "", spec.Fields["View0"], "View0 left in fields")
+	assert.Equal(s.T(), client, spec.Dictionary(), "Flattened spec differs from RunFetch")
+
+	// Streamed output is numbered out as Run's is
+	for r, err := range s.p4api.RunStream("client", "-o") {
+		assert.Nil(s.T(), err, "Failed to stream client -o")
+		assert.Equal(s.T(), client, r, "Streamed spec differs from RunFetch")
+	}
+
+	views := []struct {
+		Client string   `p4:"Client"`
+		View   []string `p4:"View"`
+	}{}
+	_, err = s.p4api.RunInto("client", &views, "-o")
+	assert.Nil(s.T(), err, "Failed to run client -o")
+	assert.Equal(s.T(), 1, len(views), "Expected one client")
+	assert.Equal(s.T(), client["Client"], views[0].Client)
+	assert.Equal(s.T(), spec.Lists["View"], views[0].View)
+
+	s.p4api.SetArrayConversion(false)
+	spec, err = s.p4api.FetchSpec("client")
+	assert.Nil(s.T(), err, "Failed to fetch client spec")
+	assert.Equal(s.T(), 0, len(spec.Lists), "Lists without array conversion")
+	assert.Equal(s.T(), client["View0"], spec.Fields["View0"])
+	s.p4api.SetArrayConversion(true)
+
+	ret, err := s.p4api.Disconnect()
+	assert.True(s.T(), ret, "should disconnect")
+	assert.Nil(s.T(), err, "should disconnect")
+	s.p4api.Close()
+}
+
+func (s *PerforceTestSuite) TestRunBatch() {
+	assert.NotNil(s.T(), s.p4api, "Failed to create Perforce client")
+
+	_, err := s.p4api.Connect()
+	assert.Nil(s.T(), err, "Failed to connect to Perforce server")
+
+	s.createClient()
+
+	for _, fn := range []string{"foo", "bar"} {
+		err := os.WriteFile(fn+".txt", []byte(fn+"\n"), 0644)
+		assert.Nil(s.T(), err, "Failed to create file")
+		_, _ = s.p4api.Run("add", fn+".txt")
+	}
+	_, err = s.p4api.RunSubmit("-d", "test")
+	assert.Nil(s.T(), err, "Failed to submit test")
+
+	s.p4api.SetPipelineWindow(2)
+	results, err := s.p4api.RunBatch(
+		P4BatchCommand{"fstat", []string{"//depot/foo.txt"}},
+		P4BatchCommand{"fstat", []string{"//depot/missing.txt"}},
+		P4BatchCommand{"print", []string{"-q", "//depot/bar.txt"}},
+		P4BatchCommand{"changes", nil},
+	)
+	s.p4api.SetPipelineWindow(64)
+	assert.Nil(s.T(), err, "Failed to run batch")
+	require.Len(s.T(), results, 4, "Expected results for every command")
+	assert.Equal(s.T(), int64(4), s.p4api.Metrics().Commands, "Batched commands not counted")
+	assert.Equal(s.T(), int64(1), s.p4api.batchMetrics(0).Commands, "Command not counted")
+
+	require.Len(s.T(), results[0], 1)
+	assert.Equal(s.T(), "//depot/foo.txt", results[0][0].(Dictionary)["depotFile"])
+
+	require.Len(s.T(), results[1], 1)
+	msg, ok := results[1][0].(P4Message)
+	assert.True(s.T(), ok, "Expected a message for a missing file")
+	assert.Contains(s.T(), msg.String(), "no such file")
+
+	data := ""
+	for _, r := range results[2] {
+		if d, ok := r.(P4Data); ok {
+			data += string(d)
+		}
+	}
+	assert.Equal(s.T(), "bar\n", data)
+
+	changes, err := s.p4api.Run("changes")
+	assert.Nil(s.T(), err, "Failed to run changes")
+	assert.Equal(s.T(), changes, results[3], "Batched changes differ from Run")
+
+	// A batch keeps every command's results until the next run, so each
+	// command's arena has to start small
+	big := make([]P4BatchCommand, 1000)
+	for i := range big {
+		big[i] = P4BatchCommand{"fstat", []string{"//depot/foo.txt"}}
+	}
+	results, err = s.p4api.RunBatch(big...)
+	assert.Nil(s.T(), err, "Failed to run batch")
+	require.Len(s.T(), results, len(big), "Expected results for every command")
+	assert.Less(s.T(), s.p4api.batchArenaReserved(), int64(len(big)*16384),
+		"Batch arenas hold too much memory")
+
+	ret, err := s.p4api.Disconnect()
+	assert.True(s.T(), ret, "should disconnect")
+	assert.Nil(s.T(), err, "should disconnect")
+	s.p4api.Close()
+}
+
+func (s *PerforceTestSuite) TestRunContext() {
+	assert.NotNil(s.T(), s.p4api, "Failed to create Perforce client")
+
+	_, err := s.p4api.Connect()
+	assert.Nil(s.T(), err, "Failed to connect to Perforce server")
+
+	ctx, cancel := context.WithTimeout(context.Background(), time.Minute)
+	results, err := s.p4api.RunContext(ctx, "info")
+	cancel()
+	assert.Nil(s.T(), err, "Failed to run info")
+	assert.NotEmpty(s.T(), results, "No info")
+
+	ctx, cancel = context.WithCancel(context.Background())
+	cancel()
+	_, err = s.p4api.RunContext(ctx, "info")
+	assert.ErrorIs(s.T(), err, context.Canceled)
+
+	// A cancelled context mustn't affect the commands that follow
+	assert.True(s.T(), s.p4api.Connected(), "Connection lost")
+	results, err = s.p4api.Run("info")
+	assert.Nil(s.T(), err, "Failed to run info")
+	assert.NotEmpty(s.T(), results, "No info")
+
+	ret, err := s.p4api.Disconnect()
+	assert.True(s.T(), ret, "should disconnect")
+	assert.Nil(s.T(), err, "should disconnect")
+	s.p4api.Close()
+}
+
+func (s *PerforceTestSuite) TestReconnect() {
+	assert.NotNil(s.T(), s.p4api, "Failed to create Perforce client")
+
+	_, err := s.p4api.Connect()
+	assert.Nil(s.T(), err, "Failed to connect to Perforce server")
+
+	s.p4api.SetReconnectPolicy(P4ReconnectPolicy{
+		Retries:  3,
+		Delay:    10 * time.Millisecond,
+		MaxDelay: 100 * time.Millisecond,
+	})
+
+	// Stopping the server drops the connection; with rsh the next
+	// connection starts a new one
+	_, _ = s.p4api.Run("admin", "stop")
+
+	results, err := s.p4api.Run("info")
+	assert.Nil(s.T(), err, "Failed to run info after the server restarted")
+	assert.NotEmpty(s.T(), results, "No info")
+	assert.True(s.T(), s.p4api.Connected(), "Connection lost")
+
+	s.p4api.SetReconnectPolicy(P4ReconnectPolicy{})
+
+	ret, err := s.p4api.Disconnect()
+	assert.True(s.T(), ret, "should disconnect")
+	assert.Nil(s.T(), err, "should disconnect")
+	s.p4api.Close()
+}
+
+func (s *PerforceTestSuite) TestPool() {
+	pool, err := NewPool(P4PoolConfig{
+		Port:   s.p4api.Port(),
+		Client: s.p4api.Client(),
+		Size:   2,
+		Warm:   1,
+		Setup: func(p4 *P4) error {
+			_, err := p4.SetCharset("none")
+			return err
+		},
+	})
+	require.NoError(s.T(), err, "Failed to create pool")
+	defer pool.Close()
+	assert.Equal(s.T(), 1, pool.Idle(), "Pool should start warm")
+
+	ctx := context.Background()
+	first, err := pool.Get(ctx)
+	require.NoError(s.T(), err, "Failed to get a connection")
+	assert.True(s.T(), first.Connected(), "Pooled connection not connected")
+	_, err = first.Run("info")
+	assert.Nil(s.T(), err, "Failed to run info")
+
+	second, err := pool.Get(ctx)
+	require.NoError(s.T(), err, "Failed to get a second connection")
+
+	// The pool is full, so a third has to wait, and gives up
+	short, cancel := context.WithTimeout(ctx, 100*time.Millisecond)
+	_, err = pool.Get(short)
+	cancel()
+	assert.ErrorIs(s.T(), err, context.DeadlineExceeded)
+
+	pool.Put(first)
+	again, err := pool.Get(ctx)
+	require.NoError(s.T(), err, "Failed to get a connection back")
+	assert.Same(s.T(), first, again, "Idle connection not reused")
+
+	// A broken connection is replaced rather than handed out again
+	_, _ = second.Disconnect()
+	pool.Put(second)
+	assert.Equal(s.T(), 0, pool.Idle(), "Broken connection kept")
+
+	pool.Put(again)
+	pool.Close()
+	_, err = pool.Get(ctx)
+	assert.ErrorIs(s.T(), err, ErrPoolClosed)
+	s.p4api.Close()
+}
+
+func (s *PerforceTestSuite) TestFilter() {
+	assert.NotNil(s.T(), s.p4api, "Failed to create Perforce client")
+
+	_, err := s.p4api.Connect()
+	assert.Nil(s.T(), err, "Failed to connect to Perforce server")
+
+	s.createClient()
+
+	for _, fn := range []string{"foo", "bar", "baz"} {
+		err := os.WriteFile(fn+".txt", []byte("Test\n"), 0644)
+		assert.Nil(s.T(), err, "Failed to create file")
+		_, _ = s.p4api.Run("add", fn+".txt")
+	}
+	_, err = s.p4api.RunSubmit("-d", "test")
+	assert.Nil(s.T(), err, "Failed to submit test")
+
+	res, err := s.p4api.RunFiltered(&P4Filter{
+		Fields: []string{"depotFile", "headRev"},
+		Where:  []P4Predicate{{Key: "depotFile", Op: P4FILTER_PREFIX, Value: "//depot/ba"}},
+	}, "fstat", "//...")
+	assert.Nil(s.T(), err, "Failed to run fstat")
+	assert.Equal(s.T(), 2, len(res), "Filter should leave two files")
+	for _, r := range res {
+		assert.Equal(s.T(), 2, len(r.(Dictionary)), "Only the projected fields should be kept")
+		assert.True(s.T(), strings.HasPrefix(r.(Dictionary)["depotFile"], "//depot/ba"))
+	}
+
+	res, _ = s.p4api.RunFiltered(&P4Filter{
+		Where: []P4Predicate{{Key: "headRev", Op: P4FILTER_GE, Value: "2"}},
+	}, "fstat", "//...")
+	assert.Equal(s.T(), 0, len(res), "No file has a second revision")
+
+	res, _ = s.p4api.Run("fstat", "//...")
+	assert.Equal(s.T(), 3, len(res), "Filter should only apply to one run")
+
+	// The helpers run their own commands, which must not be filtered
+	_, _ = s.p4api.RunFiltered(&P4Filter{
+		Fields: []string{"Owner"},
+		Where:  []P4Predicate{{Key: "Owner", Op: P4FILTER_EQ, Value: "nobody"}},
+	}, "clients")
+	clients, err := s.p4api.SpecIterator("clients")
+	assert.Nil(s.T(), err, "Failed to iterate clients")
+	assert.Equal(s.T(), 1, len(clients), "Expected one client spec")
+	assert.Equal(s.T(), s.p4api.Client(), clients[0]["Client"], "Client name lost")
+
+	_, _ = s.p4api.RunFiltered(&P4Filter{Fields: []string{"depotFile"}}, "filelog", "//...")
+	filelog, err := s.p4api.RunFilelog("//depot/foo.txt")
+	assert.Nil(s.T(), err, "Failed to run filelog")
+	assert.Equal(s.T(), 1, len(filelog), "Expected one file")
+	assert.Equal(s.T(), 1, len(filelog[0].Revisions), "Revision lost")
+	assert.Equal(s.T(), 1, filelog[0].Revisions[0].Rev, "Revision number lost")
+
+	ret, err := s.p4api.Disconnect()
+	assert.True(s.T(), ret, "should disconnect")
+	assert.Nil(s.T(), err, "should disconnect")
+	s.p4api.Close()
+}
+
+func (s *PerforceTestSuite) TestWideRecords() {
+	assert.NotNil(s.T(), s.p4api, "Failed to create Perforce client")
+
+	_, err := s.p4api.Connect()
+	assert.Nil(s.T(), err, "Failed to connect to Perforce server")
+
+	s.createClient()
+
+	// Records with more than 32 keys are looked up through a hash index
+	// rather than a scan, so build a change and a file history well past
+	// that. With a hundred or so keys in the index, probes have to step
+	// over slots taken by other keys to find the one asked for.
+	files := 10
+	for i := 0; i < files; i++ {
+		err := os.WriteFile(fmt.Sprintf("wide%d.txt", i), []byte("Test\n"), 0644)
+		assert.Nil(s.T(), err, "Failed to create file")
+		_, _ = s.p4api.Run("add", fmt.Sprintf("wide%d.txt", i))
+	}
+	_, err = s.p4api.RunSubmit("-d", "wide change")
+	require.Nil(s.T(), err, "Failed to submit wide change")
+
+	revs := 8
+	for i := 2; i <= revs; i++ {
+		_, _ = s.p4api.Run("edit", "wide0.txt")
+		err := os.WriteFile("wide0.txt", []byte(fmt.Sprintf("Revision %d\n", i)), 0644)
+		assert.Nil(s.T(), err, "Failed to edit file")
+		_, err = s.p4api.RunSubmit("-d", fmt.Sprintf("revision %d", i))
+		require.Nil(s.T(), err, "Failed to submit revision")
+	}
+
+	res, err := s.p4api.Run("describe", "-s", "1")
+	require.Nil(s.T(), err, "Failed to describe change")
+	require.Len(s.T(), res, 1)
+	desc := res[0].(Dictionary)
+	assert.Greater(s.T(), len(desc), 32, "Describe record should be wide")
+	for i := 0; i < files; i++ {
+		assert.Equal(s.T(), "1", desc[fmt.Sprintf("rev%d", i)], "Revision %d lost", i)
+		assert.NotEmpty(s.T(), desc[fmt.Sprintf("depotFile%d", i)], "File %d lost", i)
+	}
+
+	// The filelog decoder finds depotFile by name in the wide record
+	raw, err := s.p4api.Run("filelog", "//depot/wide0.txt")
+	require.Nil(s.T(), err, "Failed to run filelog")
+	require.Len(s.T(), raw, 1)
+	assert.Greater(s.T(), len(raw[0].(Dictionary)), 32, "Filelog record should be wide")
+
+	filelog, err := s.p4api.RunFilelog("//depot/wide0.txt")
+	require.Nil(s.T(), err, "Failed to run filelog")
+	require.Len(s.T(), filelog, 1)
+	assert.Equal(s.T(), "//depot/wide0.txt", filelog[0].Name, "Depot file lost")
+	require.Len(s.T(), filelog[0].Revisions, revs, "Revisions lost")
+	for i, rev := range filelog[0].Revisions {
+		assert.Equal(s.T(), revs-i, rev.Rev, "Revisions out of order")
+	}
+
+	h := map[string]interface{}{}
+	for k, v := range raw[0].(Dictionary) {
+		h[k] = v
+	}
+	df, err := ProcessFilelog(h)
+	require.NoError(s.T(), err, "Failed to process filelog")
+	assert.Equal(s.T(), df, filelog[0], "Filelog decoders disagree")
+
+	ret, err := s.p4api.Disconnect()
+	assert.True(s.T(), ret, "should disconnect")
+	assert.Nil(s.T(), err, "should disconnect")
+	s.p4api.Close()
+}
+
 func (s *PerforceTestSuite) TestTrack() {
 	assert.NotNil(s.T(), s.p4api, "Failed to create Perforce client")
 	_, err := s.p4api.SetTrack(true)
@@ -1850,6 +2635,24 @@ func (s *PerforceTestSuite) TestTrack() {
 
 	assert.True(s.T(), found, "Failed to report expected performance tracking output")
 
+	// The same output, parsed
+	track := s.p4api.TrackData()
+	assert.Equal(s.T(), 1, track.Commands)
+	assert.True(s.T(), track.RpcMsgsIn > 0, "No RPC messages reported")
+
+	s.p4api.ResetTrackTotals()
+	_, err = s.p4api.Run("depots")
+	assert.Nil(s.T(), err, "Failed to run depots")
+	_, err = s.p4api.Run("depots")
+	assert.Nil(s.T(), err, "Failed to run depots")
+	once, ok := s.p4api.TrackData().Table("db.depot")
+	assert.True(s.T(), ok, "No track data for db.depot")
+	totals := s.p4api.TrackTotals()
+	assert.Equal(s.T(), 2, totals.Commands)
+	twice, ok := totals.Table("db.depot")
+	assert.True(s.T(), ok, "No track totals for db.depot")
+	assert.Equal(s.T(), 2*once.ReadLocks, twice.ReadLocks)
+
 	ret, err := s.p4api.Disconnect()
 	assert.True(s.T(), ret, "should disconnect")
 	assert.Nil(s.T(), err, "should disconnect")
@@ -2007,6 +2810,15 @@ func (s *PerforceTestSuite) TestStream() {
 		assert.Equal(s.T(), "share ...", nstreamSpec["Paths0"])
 		assert.Equal(s.T(), "## Inline comment", nstreamSpec["PathsComment0"])
 		assert.Equal(s.T(), "## Newline comment", nstreamSpec["PathsComment2"])
+		s.compareSpecForm("stream", "//Stream/MAIN")
+
+		// The comments stay numbered keys when the lists are gathered up
+		fetched, err := s.p4api.FetchSpec("stream", "//Stream/MAIN")
+		assert.Nil(s.T(), err, "Failed to fetch stream")
+		require.NotEmpty(s.T(), fetched.Lists["Paths"], "Paths not gathered up")
+		assert.Equal(s.T(), "share ...", fetched.Lists["Paths"][0])
+		assert.Equal(s.T(), "## Inline comment", fetched.Fields["PathsComment0"])
+		assert.Equal(s.T(), "## Newline comment", fetched.Fields["PathsComment2"])
 
 	} else {
 		fmt.Println("\tTest Skipped: Streams requires a 2011.1 or later Perforce Server and P4API.")
@@ -2017,6 +2829,151 @@ func (s *PerforceTestSuite) TestStream() {
 	s.p4api.Close()
 }
 
+func (s *PerforceTestSuite) TestSpecCache() {
+	JOBSPEC := `Fields:
+        101 Job word 32 required
+        102 Status select 10 required
+        103 User word 32 required
+        104 Date date 20 always
+        105 Description text 0 required
+%s
+Values:
+        Status open/suspended/closed
+
+Presets:
+        Status open
+        User $user
+        Date $now
+        Description $blank`
+
+	assert.NotNil(s.T(), s.p4api, "Failed to create Perforce client")
+
+	_, err := s.p4api.Connect()
+	assert.Nil(s.T(), err, "Failed to connect to Perforce server")
+	assert.True(s.T(), s.p4api.Connected(), "Failed to connect to Perforce server")
+
+	_, err = s.p4api.Run("jobspec", "-i", fmt.Sprintf(JOBSPEC, ""))
+	require.Nil(s.T(), err, "Failed to save jobspec")
+
+	job, err := s.p4api.RunFetch("job")
+	require.Nil(s.T(), err, "Failed to fetch job")
+	job["Field2"] = "extra"
+	form, err := s.p4api.FormatSpec("job", job)
+	require.Nil(s.T(), err, "Failed to format job")
+	assert.NotContains(s.T(), form, "Field2", "Field the jobspec lacks was formatted")
+
+	// Fetching a job after the jobspec changes hands the spec manager a
+	// new specdef, which has to replace the parsed one it has cached
+	_, err = s.p4api.Run("jobspec", "-i",
+		fmt.Sprintf(JOBSPEC, "        106 Field2 word 32 optional\n"))
+	require.Nil(s.T(), err, "Failed to change jobspec")
+
+	job, err = s.p4api.RunFetch("job")
+	require.Nil(s.T(), err, "Failed to fetch job")
+	job["Field2"] = "extra"
+	form, err = s.p4api.FormatSpec("job", job)
+	require.Nil(s.T(), err, "Failed to format job")
+	assert.Contains(s.T(), form, "Field2:\textra", "Stale jobspec used to format")
+
+	msg, err := s.p4api.RunSave("job", job)
+	require.Nil(s.T(), err, "Failed to save job")
+	assert.Contains(s.T(), msg.String(), "saved", "Failed to save job")
+	job, err = s.p4api.RunFetch("job", "job000001")
+	require.Nil(s.T(), err, "Failed to fetch job")
+	assert.Equal(s.T(), "extra", job["Field2"], "Stale jobspec used to convert")
+
+	// Disconnecting drops the server's specdefs, leaving the default
+	// jobspec, which has no Field2
+	_, err = s.p4api.Disconnect()
+	assert.Nil(s.T(), err, "should disconnect")
+	form, err = s.p4api.FormatSpec("job", job)
+	require.Nil(s.T(), err, "Failed to format job")
+	assert.NotContains(s.T(), form, "Field2", "Server jobspec kept after disconnect")
+
+	_, err = s.p4api.Connect()
+	assert.Nil(s.T(), err, "Failed to reconnect to Perforce server")
+	job, err = s.p4api.RunFetch("job", "job000001")
+	require.Nil(s.T(), err, "Failed to fetch job")
+	assert.Equal(s.T(), "extra", job["Field2"], "Jobspec not relearned")
+
+	ret, err := s.p4api.Disconnect()
+	assert.True(s.T(), ret, "should disconnect")
+	assert.Nil(s.T(), err, "should disconnect")
+	s.p4api.Close()
+}
+
+// compareSpecForm fetches a spec both tagged and as an untagged form,
+// and checks that every field parsed from the form comes out the same
+// from the tagged conversion, and from formatting and reparsing it.
+func (s *PerforceTestSuite) compareSpecForm(spec string, args ...string) {
+	tagged, err := s.p4api.RunFetch(spec, args...)
+	s.Require().NoError(err, "Failed to fetch %s", spec)
+
+	s.p4api.SetTagged(false)
+	raw, err := s.p4api.Run(spec, append([]string{"-o"}, args...)...)
+	s.p4api.SetTagged(true)
+	s.Require().NoError(err, "Failed to fetch %s form", spec)
+
+	form := ""
+	for _, r := range raw {
+		switch v := r.(type) {
+		case P4Data:
+			form += string(v)
+		case P4Message:
+			form += v.String() + "\n"
+		}
+	}
+	parsed, err := s.p4api.ParseSpec(spec, form)
+	s.Require().NoError(err, "Failed to parse %s form", spec)
+	require.NotEmpty(s.T(), parsed, "No fields parsed from %s form", spec)
+
+	// The tagged spec may carry extra tags the form doesn't, so only the
+	// form's fields are compared
+	for k, v := range parsed {
+		assert.Equal(s.T(), v, tagged[k], "%s field %s differs from the form", spec, k)
+	}
+
+	formatted, err := s.p4api.FormatSpec(spec, tagged)
+	s.Require().NoError(err, "Failed to format %s", spec)
+	reparsed, err := s.p4api.ParseSpec(spec, formatted)
+	s.Require().NoError(err, "Failed to reparse %s", spec)
+	assert.Equal(s.T(), parsed, reparsed, "%s does not round trip", spec)
+}
+
+func (s *PerforceTestSuite) TestSpecRegistry() {
+	open := func() *P4 {
+		p4 := New()
+		_, _ = p4.SetCharset("none")
+		p4.SetPort(s.p4api.Port())
+		p4.SetClient(s.p4api.Client())
+		_, err := p4.Connect()
+		require.Nil(s.T(), err, "Failed to connect to Perforce server")
+		return p4
+	}
+
+	before := specSetCount()
+
+	first := open()
+	_, err := first.RunFetch("client")
+	assert.Nil(s.T(), err, "Failed to fetch client")
+	shared := specSetCount()
+	assert.LessOrEqual(s.T(), shared, before+1, "One connection should publish at most one set")
+
+	// A second connection to the server learns the same specdef, and
+	// should end up on the first's set rather than publishing another
+	second := open()
+	_, err = second.RunFetch("client")
+	assert.Nil(s.T(), err, "Failed to fetch client")
+	assert.Equal(s.T(), shared, specSetCount(), "Connections to one server should share one set")
+
+	for _, p4 := range []*P4{first, second} {
+		_, _ = p4.Disconnect()
+		p4.Close()
+	}
+	assert.Equal(s.T(), before, specSetCount(), "Sets should be dropped with their connections")
+	s.p4api.Close()
+}
+
 func (s *PerforceTestSuite) TestSpecIterator() {
 	assert.NotNil(s.T(), s.p4api, "Failed to create Perforce client")
 
@@ -2046,6 +3003,34 @@ func (s *PerforceTestSuite) TestSpecIterator() {
 		}
 	}
 
+	// The fetches are pipelined; a window of one must give the same
+	// specs in the same order as the label list
+	s.p4api.SetPipelineWindow(1)
+	ordered, err := s.p4api.SpecIterator("labels")
+	assert.NoError(s.T(), err, "Failed to iterate labels")
+	require.Len(s.T(), ordered, 2, "Unexpected number of labels")
+	assert.Equal(s.T(), "label1", ordered[0]["Label"])
+	assert.Equal(s.T(), "label2", ordered[1]["Label"])
+
+	// Streamed, each listed spec is yielded in turn
+	var streamed []string
+	for l, err := range s.p4api.SpecStream("labels") {
+		assert.NoError(s.T(), err, "Failed to fetch label")
+		streamed = append(streamed, l["Label"])
+	}
+	assert.Equal(s.T(), []string{"label1", "label2"}, streamed)
+	s.p4api.SetPipelineWindow(64)
+
+	// A fetch that fails is reported, rather than dropped
+	failed := P4Message{severity: P4MESSAGE_FAILED,
+		lines: []P4MessageLine{{severity: P4MESSAGE_FAILED, fmt: "No such label."}}}
+	d, err := specResult([]P4Result{failed})
+	assert.Nil(s.T(), d, "No spec was fetched")
+	assert.ErrorContains(s.T(), err, "No such label.")
+	d, err = specResult([]P4Result{})
+	assert.Nil(s.T(), d, "No spec was fetched")
+	assert.Error(s.T(), err, "A missing spec should be an error")
+
 	labels, _ := s.p4api.SpecIterator("labels", "-e", "label1", "-m1")
 
 	for _, l := range labels {
@@ -2916,6 +3901,69 @@ func (s *PerforceTestSuite) TestProgress() {
 	s.p4api.Close()
 }
 
+func (s *PerforceTestSuite) TestParallelSync() {
+	assert.NotNil(s.T(), s.p4api, "Failed to create Perforce client")
+	_, err := s.p4api.Connect()
+	assert.Nil(s.T(), err, "Failed to connect to Perforce server")
+	s.createClient()
+
+	_, err = s.p4api.Run("configure", "set", "net.parallel.max=4")
+	require.Nil(s.T(), err, "Failed to enable parallel transfers")
+
+	err = os.Mkdir("parallel_files", 0755)
+	require.Nil(s.T(), err, "Failed to create directory")
+	total := 20
+	for n := range total {
+		filepath := fmt.Sprintf("parallel_files/file%d.txt", n)
+		err := os.WriteFile(filepath, []byte(strings.Repeat("*", 1024)), 0644)
+		require.Nil(s.T(), err, "Failed to create file")
+		_, _ = s.p4api.Run("add", filepath)
+	}
+	_, err = s.p4api.RunSubmit("-d", "parallel")
+	assert.Nil(s.T(), err, "Failed to submit test")
+
+	_, err = s.p4api.Run("sync", "-q", "parallel_files/...#none")
+	assert.Nil(s.T(), err, "Failed to remove files")
+
+	prog := &SubmitP4Progress{}
+	s.p4api.SetProgress(prog)
+	s.p4api.SetTrace(64)
+	results, err := s.p4api.Run("sync", "--parallel=threads=4,min=1,minsize=1", "parallel_files/...")
+	assert.Nil(s.T(), err, "Failed to sync in parallel")
+	s.p4api.SetProgress(nil)
+
+	// The files must have gone through the in-process workers, not
+	// forked p4 processes or a single connection
+	transfers := 0
+	for _, e := range s.p4api.Trace() {
+		if e.Type == P4TRACE_TRANSFER {
+			transfers++
+			assert.Greater(s.T(), e.Arg, 1, "Transfer should use several threads")
+		}
+	}
+	s.p4api.SetTrace(0)
+	assert.Equal(s.T(), 1, transfers, "Expected one parallel transfer")
+
+	// The workers' progress comes to the handler as whole indicators
+	assert.NotEmpty(s.T(), prog.types, "Workers reported no progress")
+	assert.Equal(s.T(), len(prog.types), len(prog.fails), "Every indicator should be done once")
+	assert.Positive(s.T(), s.p4api.Metrics().Crossings, "Progress callbacks not metered")
+	for _, r := range results {
+		if msg, ok := r.(P4Message); ok {
+			assert.Less(s.T(), msg.Severity(), P4MESSAGE_FAILED, "Unexpected error: %s", msg.String())
+		}
+	}
+	for n := range total {
+		_, err := os.Stat(fmt.Sprintf("parallel_files/file%d.txt", n))
+		assert.Nil(s.T(), err, "File was not transferred")
+	}
+
+	ret, err := s.p4api.Disconnect()
+	assert.True(s.T(), ret, "should disconnect")
+	assert.Nil(s.T(), err, "should disconnect")
+	s.p4api.Close()
+}
+
 /*
 ############################################
   Start of the test for the trust command
@@ -25,6 +25,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 *******************************************************************************/
 
+#include <atomic>
 #include <p4/clientapi.h>
 #include <p4/vararray.h>
 #include <p4/strtable.h>
@@ -32,8 +33,16 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <p4/spec.h>
 #include <p4/mapapi.h>
 #include "p4gospecmgr.h"
+#include "p4goarena.h"
+#include "p4gohashindex.h"
+#include "p4gospecregistry.h"
+#include "p4gokeytable.h"
 #include "p4goresult.h"
+#include "p4gofilter.h"
 #include "p4gomergedata.h"
+#include "p4gometrics.h"
+#include "p4gotrack.h"
+#include "p4gotrace.h"
 #include "p4goclientuser.h"
 #include "p4goclientapi.h"
 #include "p4go.h"
@@ -87,6 +96,34 @@ Run( P4GoClientApi* api, char* cmd, int argc, char** argv, Error* e )
     api->Run( cmd, argc, argv, e );
 }
 
+//
+// The one call that may be made while another thread is in Run(): it
+// makes the client's KeepAlive check fail, which stops the command.
+//
+
+void
+SetCancelled( P4GoClientApi* api, int cancelled )
+{
+    api->SetCancelled( cancelled );
+}
+
+int
+WasCancelled( P4GoClientApi* api )
+{
+    return api->WasCancelled();
+}
+
+int
+RunBatch( P4GoClientApi* api,
+          int count,
+          char** cmds,
+          int* argcs,
+          char** argv,
+          Error* e )
+{
+    return api->RunBatch( count, cmds, argcs, argv, e );
+}
+
 int
 ResultCount( P4GoClientApi* api )
 {
@@ -103,12 +140,182 @@ ResultGet( P4GoClientApi* api, int index, int* type, P4GoResult** ret )
     return *ret != 0;
 }
 
+//
+// Pack the whole result set into one buffer. The buffer remains owned by
+// the results, so the caller must not free it and must have finished with
+// it before the next command is run. Specs keep their lists if asked to.
+//
+const char*
+ResultGetAll( P4GoClientApi* api, int lists, int* len )
+{
+    const StrPtr& buf = api->GetResults()->Pack( 0, true, lists != 0 );
+    *len = buf.Length();
+    return buf.Text();
+}
+
+//
+// As ResultGetAll(), but with tagged output laid out by column
+//
+const char*
+ResultGetColumns( P4GoClientApi* api, int* len )
+{
+    const StrPtr& buf = api->GetResults()->PackColumns();
+    *len = buf.Length();
+    return buf.Text();
+}
+
+const char*
+ResultGetFilelog( P4GoClientApi* api, int* len )
+{
+    const StrPtr& buf = api->GetResults()->PackFilelog();
+    *len = buf.Length();
+    return buf.Text();
+}
+
+//
+// The results of one command of the last RunBatch(), as for ResultGetAll()
+//
+
+const char*
+BatchResultGetAll( P4GoClientApi* api, int cmd, int* len )
+{
+    P4GoResults* results = api->BatchResults( cmd );
+
+    *len = 0;
+    if( !results )
+        return 0;
+
+    const StrPtr& buf = results->Pack( 0, true );
+    *len = buf.Length();
+    return buf.Text();
+}
+
+void
+FilterClear( P4GoClientApi* api )
+{
+    api->GetFilter()->Clear();
+}
+
+void
+FilterProject( P4GoClientApi* api, char* key )
+{
+    api->GetFilter()->Project( key );
+}
+
+void
+FilterWhere( P4GoClientApi* api, char* key, int op, char* value )
+{
+    api->GetFilter()->Where( key, op, value );
+}
+
+long long
+ResultArenaHighWater( P4GoClientApi* api )
+{
+    return api->GetResults()->Arena()->HighWater();
+}
+
+long long
+BatchArenaReserved( P4GoClientApi* api )
+{
+    long long n = 0;
+    for( int i = 0; i < api->BatchCount(); i++ )
+        n += api->BatchResults( i )->Arena()->Reserved();
+    return n;
+}
+
+void
+SetResultArenaSize( P4GoClientApi* api, int size )
+{
+    api->GetResults()->Arena()->SetChunkSize( size );
+}
+
+void
+GetMetrics( P4GoClientApi* api, int total, P4GoMetrics* m )
+{
+    *m = total ? api->GetTotalMetrics() : api->GetMetrics();
+}
+
+void
+ResetMetrics( P4GoClientApi* api )
+{
+    api->ResetMetrics();
+}
+
+//
+// The -Ztrack figures as packed by P4GoTrack. The buffer belongs to the
+// API, and lasts until the next call.
+//
+
+const char*
+TrackGet( P4GoClientApi* api, int total, int* len )
+{
+    P4GoTrack* t = total ? api->GetTrackTotal() : api->GetTrackData();
+    const StrPtr& buf = t->Pack();
+    *len = buf.Length();
+    return buf.Text();
+}
+
+void
+TrackReset( P4GoClientApi* api )
+{
+    api->GetTrackTotal()->Clear();
+}
+
+void
+BatchGetMetrics( P4GoClientApi* api, int cmd, P4GoMetrics* m )
+{
+    const P4GoMetrics* b = api->BatchMetrics( cmd );
+    if( b )
+        *m = *b;
+    else
+        memset( m, 0, sizeof( *m ) );
+}
+
+const char*
+BatchTrackGet( P4GoClientApi* api, int cmd, int* len )
+{
+    P4GoTrack* t = api->BatchTrackData( cmd );
+
+    *len = 0;
+    if( !t )
+        return 0;
+
+    const StrPtr& buf = t->Pack();
+    *len = buf.Length();
+    return buf.Text();
+}
+
+void
+SetTraceSize( P4GoClientApi* api, int size )
+{
+    api->SetTraceSize( size );
+}
+
+//
+// The trace events, oldest first. As with TrackGet(), the buffer belongs
+// to the API, and lasts until the next call.
+//
+
+const char*
+TraceDump( P4GoClientApi* api, int* len )
+{
+    const StrPtr& buf = api->GetTrace()->Dump();
+    *len = buf.Length();
+    return buf.Text();
+}
+
+void
+TraceClear( P4GoClientApi* api )
+{
+    api->GetTrace()->Clear();
+}
+
 const char*
 ResultGetString( P4GoResult* ret )
 {
     if( ret->type == STRING || ret->type == TRACK ) {
-        char* r = (char*)malloc( ret->str->Length() + 1 );
-        strcpy( r, ret->str->Text() );
+        char* r = (char*)malloc( ret->str.Length() + 1 );
+        strcpy( r, ret->str.Text() );
         return r;
     } else if( ret->type == ERROR ) {
         StrBuf msg;
@@ -120,14 +327,17 @@ ResultGetString( P4GoResult* ret )
     return 0;
 }
 
-const char* 
+//
+// Binary results are returned in place rather than copied: the data may
+// contain NULs and may be large. The pointer belongs to the results and
+// is valid until the next command is run.
+//
+const char*
 ResultGetBinary( P4GoResult* ret, int* len )
 {
     if( ret->type == BINARY ) {
-        char* r = (char*)malloc( ret->str->Length() + 1 );
-        strcpy( r, ret->str->Text() );
-        *len = ret->str->Length();
-        return r;
+        *len = ret->str.Length();
+        return ret->str.Text();
     }
     return 0;
 }
@@ -153,7 +363,7 @@ ResultGetKeyPair( P4GoResult* ret, int index, char** var, char** val )
         }
     } else if( ret->type == SPEC ) {
         StrRef svar, sval;
-        if( ret->spec->Dict()->GetVar( index, svar, sval ) ) {
+        if( ret->spec->Flat()->GetVar( index, svar, sval ) ) {
             *var = svar.Text();
             *val = sval.Text();
             return 1;
@@ -196,6 +406,12 @@ SetStreams( P4GoClientApi* api, int enableStreams )
     api->SetStreams( enableStreams );
 }
 
+void
+SetArrayConversion( P4GoClientApi* api, int convert )
+{
+    api->SetArrayConversion( convert );
+}
+
 int
 GetTagged( P4GoClientApi* api )
 {
@@ -492,6 +708,30 @@ SetMaxLockTime( P4GoClientApi* api, int maxLockTime )
     return api->SetMaxLockTime( maxLockTime );
 }
 
+int
+GetPipelineWindow( P4GoClientApi* api )
+{
+    return api->GetPipelineWindow();
+}
+
+void
+SetPipelineWindow( P4GoClientApi* api, int window )
+{
+    api->SetPipelineWindow( window );
+}
+
+void
+SetReconnect( P4GoClientApi* api, int retries, int delay, int maxDelay )
+{
+    api->SetReconnect( retries, delay, maxDelay );
+}
+
+void
+SetIdempotent( P4GoClientApi* api, char* cmd, int idempotent )
+{
+    api->SetIdempotent( cmd, idempotent );
+}
+
 void
 ResetInput( P4GoClientApi* api )
 {
@@ -516,6 +756,12 @@ FormatSpec( P4GoClientApi* api, char* spec, StrDict* dict, Error* e )
     return api->FormatSpec( spec, dict, e );
 }
 
+int
+SpecRegistryCount()
+{
+    return P4GoSpecRegistry::Count();
+}
+
 int
 P4ServerLevel( P4GoClientApi* api, Error* e )
 {
@@ -658,6 +904,36 @@ StrDictGetKeyPair( StrDict* dict, int index, char** var, char** val )
     return 0;
 }
 
+P4GoStream*
+NewStream()
+{
+    return new P4GoStream( cbStream );
+}
+
+void
+FreeStream( P4GoStream* stream )
+{
+    delete stream;
+}
+
+void
+SetStream( P4GoClientApi* api, P4GoStream* stream )
+{
+    api->SetStream( stream );
+}
+
+P4GoStream*
+GetStream( P4GoClientApi* api )
+{
+    return api->GetStream();
+}
+
+void
+SetStreamBatch( P4GoStream* stream, int records, int bytes, int ms )
+{
+    stream->SetBatch( records, bytes, ms );
+}
+
 P4GoSSOHandler*
 NewSSOHandler()
 {
@@ -704,7 +980,7 @@ int
 SpecDataGetKeyPair( P4GoSpecData* spec, int index, char** var, char** val )
 {
     StrRef svar, sval;
-    if( spec->Dict()->GetVar( index, svar, sval ) ) {
+    if( spec->Flat()->GetVar( index, svar, sval ) ) {
         *var = svar.Text();
         *val = sval.Text();
         return 1;
@@ -33,6 +33,7 @@ typedef struct StrDict StrDict;
 typedef struct StrBufDict StrBufDict;
 typedef struct P4GoHandler P4GoHandler;
 typedef struct P4GoSSOHandler P4GoSSOHandler;
+typedef struct P4GoStream P4GoStream;
 typedef struct P4GoResolveHandler P4GoResolveHandler;
 typedef struct P4GoSpecData P4GoSpecData;
 typedef struct MapApi MapApi;
@@ -54,10 +55,48 @@ extern "C"
     int P4Connected( P4GoClientApi* api );
     int P4Disconnect( P4GoClientApi* api, Error* e );
     void Run( P4GoClientApi* api, char* cmd, int argc, char** argv, Error* e );
+    void SetCancelled( P4GoClientApi* api, int cancelled );
+    int WasCancelled( P4GoClientApi* api );
+    int RunBatch( P4GoClientApi* api,
+                  int count,
+                  char** cmds,
+                  int* argcs,
+                  char** argv,
+                  Error* e );
 
     // Result handlers
     int ResultCount( P4GoClientApi* api );
     int ResultGet( P4GoClientApi* api, int index, int* type, P4GoResult** ret );
+    const char* ResultGetAll( P4GoClientApi* api, int lists, int* len );
+    const char* ResultGetColumns( P4GoClientApi* api, int* len );
+    const char* ResultGetFilelog( P4GoClientApi* api, int* len );
+    const char* BatchResultGetAll( P4GoClientApi* api, int cmd, int* len );
+
+    // Filtering of tagged output
+    void FilterClear( P4GoClientApi* api );
+    void FilterProject( P4GoClientApi* api, char* key );
+    void FilterWhere( P4GoClientApi* api, char* key, int op, char* value );
+    long long ResultArenaHighWater( P4GoClientApi* api );
+    void SetResultArenaSize( P4GoClientApi* api, int size );
+    long long BatchArenaReserved( P4GoClientApi* api );
+
+    // Metrics, of the last run or, with total set, of all of them
+    void GetMetrics( P4GoClientApi* api, int total, P4GoMetrics* m );
+    void ResetMetrics( P4GoClientApi* api );
+
+    // Parsed -Ztrack output, of the last run or, with total set, of all
+    const char* TrackGet( P4GoClientApi* api, int total, int* len );
+    void TrackReset( P4GoClientApi* api );
+
+    // The same for one command of the last RunBatch()
+    void BatchGetMetrics( P4GoClientApi* api, int cmd, P4GoMetrics* m );
+    const char* BatchTrackGet( P4GoClientApi* api, int cmd, int* len );
+
+    // The trace ring, packed by P4GoTrace::Dump()
+    void SetTraceSize( P4GoClientApi* api, int size );
+    const char* TraceDump( P4GoClientApi* api, int* len );
+    void TraceClear( P4GoClientApi* api );
+
     const char* ResultGetString( P4GoResult* ret );
     const char* ResultGetBinary( P4GoResult* ret, int* len );
     Error* ResultGetError( P4GoResult* ret );
@@ -73,6 +112,7 @@ extern "C"
     void SetApiLevel( P4GoClientApi* api, int apiLevel );
     int GetStreams( P4GoClientApi* api );
     void SetStreams( P4GoClientApi* api, int enableStreams );
+    void SetArrayConversion( P4GoClientApi* api, int convert );
     int GetTagged( P4GoClientApi* api );
     void SetTagged( P4GoClientApi* api, int enableTagged );
     int GetTrack( P4GoClientApi* api );
@@ -122,6 +162,10 @@ extern "C"
     void SetMaxScanRows( P4GoClientApi* api, int maxScanRows );
     int GetMaxLockTime( P4GoClientApi* api );
     void SetMaxLockTime( P4GoClientApi* api, int maxLockTime );
+    int GetPipelineWindow( P4GoClientApi* api );
+    void SetPipelineWindow( P4GoClientApi* api, int window );
+    void SetReconnect( P4GoClientApi* api, int retries, int delay, int maxDelay );
+    void SetIdempotent( P4GoClientApi* api, char* cmd, int idempotent );
 
     void ResetInput( P4GoClientApi* api );
     void AppendInput( P4GoClientApi* api, char* input );
@@ -129,6 +173,9 @@ extern "C"
     P4GoSpecData* ParseSpec( P4GoClientApi* api, char* spec, char* form, Error* e );
     char* FormatSpec( P4GoClientApi* api, char* spec, StrDict* dict, Error* e );
 
+    // How many specdef sets are shared between the connections
+    int SpecRegistryCount();
+
     int P4ServerLevel( P4GoClientApi* api, Error* e );
     int P4ServerCaseSensitive( P4GoClientApi* api, Error* e );
     int P4ServerUnicode( P4GoClientApi* api, Error* e );
@@ -157,6 +204,12 @@ extern "C"
     void SetHandler( P4GoClientApi* api, P4GoHandler* handler );
     P4GoHandler* GetHandler( P4GoClientApi* api );
 
+    P4GoStream* NewStream();
+    void FreeStream( P4GoStream* stream );
+    void SetStream( P4GoClientApi* api, P4GoStream* stream );
+    P4GoStream* GetStream( P4GoClientApi* api );
+    void SetStreamBatch( P4GoStream* stream, int records, int bytes, int ms );
+
     P4GoSSOHandler* NewSSOHandler();
     void FreeSSOHandler( P4GoSSOHandler* handler );
     void SetSSOHandler( P4GoClientApi* api, P4GoSSOHandler* handler );
@@ -0,0 +1,311 @@
+/*******************************************************************************
+
+Copyright (c) 2024, Perforce Software, Inc.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+#include <new>
+#include <p4/clientapi.h>
+#include "p4goarena.h"
+#include "p4gohashindex.h"
+#include "p4gokeytable.h"
+
+// Every allocation is rounded up to keep the next one aligned
+#define ARENA_ALIGN( n ) ( ( ( n ) + 7 ) & ~7 )
+
+// Chunk sizes: the default initial chunk, the smallest it may be set to,
+// and the largest we will grow to when a result set overflows it.
+#define ARENA_CHUNK 65536
+#define ARENA_MINCHUNK 1024
+#define ARENA_MAXCHUNK ( 8 * 1024 * 1024 )
+
+// Dicts wider than this are hash indexed on lookup
+#define DICT_INDEX_MIN 32
+
+P4GoArena::P4GoArena()
+{
+    // The initial chunk isn't made until something is allocated, so that
+    // its size can still be set
+    chunkSize = ARENA_CHUNK;
+    chunks = 0;
+    used = 0;
+    highWater = 0;
+}
+
+P4GoArena::~P4GoArena()
+{
+    while( chunks ) {
+        Chunk* n = chunks->next;
+        free( chunks );
+        chunks = n;
+    }
+}
+
+P4GoArena::Chunk*
+P4GoArena::NewChunk( int size )
+{
+    Chunk* c = (Chunk*)malloc( sizeof( Chunk ) + size );
+    c->next = 0;
+    c->size = size;
+    c->used = 0;
+    return c;
+}
+
+void*
+P4GoArena::Alloc( int size )
+{
+    size = ARENA_ALIGN( size );
+
+    if( !chunks || chunks->used + size > chunks->size ) {
+        // Grow geometrically, but never less than the request itself
+        int n = chunks ? chunks->size * 2 : chunkSize;
+        if( chunks && n > ARENA_MAXCHUNK )
+            n = ARENA_MAXCHUNK;
+        if( n < size )
+            n = size;
+        Chunk* c = NewChunk( n );
+        c->next = chunks;
+        chunks = c;
+    }
+
+    void* p = Data( chunks ) + chunks->used;
+    chunks->used += size;
+
+    used += size;
+    if( used > highWater )
+        highWater = used;
+
+    return p;
+}
+
+char*
+P4GoArena::Copy( const char* data, int len )
+{
+    char* p = (char*)Alloc( len + 1 );
+    memcpy( p, data, len );
+    p[len] = 0;
+    return p;
+}
+
+void
+P4GoArena::Reset()
+{
+    used = 0;
+    if( !chunks )
+        return;
+
+    // Free all but the initial chunk, which is the last in the list
+    while( chunks->next ) {
+        Chunk* n = chunks->next;
+        free( chunks );
+        chunks = n;
+    }
+
+    // Pick up any change to the initial chunk size
+    if( chunks->size != chunkSize ) {
+        free( chunks );
+        chunks = NewChunk( chunkSize );
+    }
+
+    chunks->used = 0;
+}
+
+void
+P4GoArena::Mark( P4GoArenaMark& m )
+{
+    m.chunk = chunks;
+    m.used = chunks ? chunks->used : 0;
+    m.total = used;
+}
+
+void
+P4GoArena::Release( const P4GoArenaMark& m )
+{
+    used = m.total;
+    if( !chunks )
+        return;
+
+    while( chunks != m.chunk && chunks->next ) {
+        Chunk* n = chunks->next;
+        free( chunks );
+        chunks = n;
+    }
+
+    chunks->used = m.used;
+}
+
+void
+P4GoArena::SetChunkSize( int size )
+{
+    chunkSize = size > ARENA_MINCHUNK ? ARENA_ALIGN( size ) : ARENA_MINCHUNK;
+}
+
+P4INT64
+P4GoArena::Reserved()
+{
+    P4INT64 n = 0;
+    for( Chunk* c = chunks; c; c = c->next )
+        n += c->size;
+    return n;
+}
+
+//
+// P4GoArenaDict
+//
+
+P4GoArenaDict::P4GoArenaDict( P4GoArena* a, P4GoKeyTable* k )
+{
+    arena = a;
+    keys = k;
+    vars = 0;
+    vals = 0;
+    ids = 0;
+    count = 0;
+    max = 0;
+    index = 0;
+    indexed = 0;
+}
+
+void
+P4GoArenaDict::Grow()
+{
+    int n = max ? max * 2 : 16;
+    StrRef* nvars = (StrRef*)arena->Alloc( n * sizeof( StrRef ) );
+    StrRef* nvals = (StrRef*)arena->Alloc( n * sizeof( StrRef ) );
+    int* nids = keys ? (int*)arena->Alloc( n * sizeof( int ) ) : 0;
+
+    for( int i = 0; i < n; i++ ) {
+        new( &nvars[i] ) StrRef;
+        new( &nvals[i] ) StrRef;
+    }
+    for( int i = 0; i < count; i++ ) {
+        nvars[i] = vars[i];
+        nvals[i] = vals[i];
+        if( ids )
+            nids[i] = ids[i];
+    }
+
+    vars = nvars;
+    vals = nvals;
+    ids = nids;
+    max = n;
+}
+
+int
+P4GoArenaDict::Find( const StrPtr& var )
+{
+    if( count <= DICT_INDEX_MIN ) {
+        for( int i = 0; i < count; i++ )
+            if( vars[i].Length() == var.Length() &&
+                !memcmp( vars[i].Text(), var.Text(), var.Length() ) )
+                return i;
+        return -1;
+    }
+
+    if( !index )
+        index = new( arena->Alloc( sizeof( P4GoHashIndex ) ) )
+            P4GoHashIndex( arena );
+
+    // Catch up with anything appended since the last lookup
+    for( ; indexed < count; indexed++ )
+        index->Insert( P4GoHashIndex::Hash( vars[indexed] ), indexed );
+
+    unsigned int h = P4GoHashIndex::Hash( var );
+    int pos = -1;
+    for( int i; ( i = index->Probe( h, pos ) ) >= 0; )
+        if( vars[i].Length() == var.Length() &&
+            !memcmp( vars[i].Text(), var.Text(), var.Length() ) )
+            return i;
+    return -1;
+}
+
+// Entries have moved, so the index has to be rebuilt from scratch
+
+void
+P4GoArenaDict::Unindex()
+{
+    if( index )
+        index->Clear();
+    indexed = 0;
+}
+
+void
+P4GoArenaDict::Append( const StrPtr& var, const StrPtr& val )
+{
+    if( count == max )
+        Grow();
+
+    if( keys ) {
+        ids[count] = keys->Intern( var );
+        vars[count] = keys->Key( ids[count] );
+    } else
+        vars[count].Set( arena->Copy( var.Text(), var.Length() ),
+                         var.Length() );
+    vals[count].Set( arena->Copy( val.Text(), val.Length() ), val.Length() );
+    count++;
+}
+
+StrPtr*
+P4GoArenaDict::VGetVar( const StrPtr& var )
+{
+    int i = Find( var );
+    return i < 0 ? 0 : &vals[i];
+}
+
+void
+P4GoArenaDict::VSetVar( const StrPtr& var, const StrPtr& val )
+{
+    int i = Find( var );
+    if( i < 0 )
+        Append( var, val );
+    else
+        vals[i].Set( arena->Copy( val.Text(), val.Length() ), val.Length() );
+}
+
+void
+P4GoArenaDict::VRemoveVar( const StrPtr& var )
+{
+    int i = Find( var );
+    if( i < 0 )
+        return;
+
+    for( count--; i < count; i++ ) {
+        vars[i] = vars[i + 1];
+        vals[i] = vals[i + 1];
+        if( ids )
+            ids[i] = ids[i + 1];
+    }
+    Unindex();
+}
+
+int
+P4GoArenaDict::VGetVarX( int x, StrRef& var, StrRef& val )
+{
+    if( x < 0 || x >= count )
+        return 0;
+
+    var = vars[x];
+    val = vals[x];
+    return 1;
+}
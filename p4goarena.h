@@ -0,0 +1,149 @@
+/*******************************************************************************
+
+Copyright (c) 2024, Perforce Software, Inc.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+//
+// P4GoArena is a simple bump allocator for result storage. Memory is
+// carved out of large chunks and is only ever released in bulk by Reset(),
+// so building and tearing down a result set costs a handful of allocations
+// per chunk rather than several per record. Nothing allocated from the
+// arena has its destructor run.
+//
+
+class P4GoKeyTable;
+class P4GoHashIndex;
+
+struct P4GoArenaMark
+{
+    void* chunk;
+    int used;
+    P4INT64 total;
+};
+
+class P4GoArena
+{
+  public:
+    P4GoArena();
+    ~P4GoArena();
+
+    // Allocate size bytes, suitably aligned for any result structure
+    void* Alloc( int size );
+
+    // Copy len bytes into the arena and NUL terminate them
+    char* Copy( const char* data, int len );
+
+    // Release everything. The initial chunk, once there is one, is kept
+    // for reuse.
+    void Reset();
+
+    // Record the current position, so that everything allocated after it
+    // can be released without disturbing what came before. A mark is only
+    // good until the next Reset().
+    void Mark( P4GoArenaMark& m );
+    void Release( const P4GoArenaMark& m );
+
+    // Size of the initial chunk. Setting this to the high-water mark of a
+    // previous run means a repeat of that command never grows the arena.
+    void SetChunkSize( int size );
+
+    int GetChunkSize() { return chunkSize; }
+
+    // Bytes allocated since the last Reset(), and the most ever allocated
+    // between two resets.
+    P4INT64 Used() { return used; }
+
+    P4INT64 HighWater() { return highWater; }
+
+    // Bytes held in chunks, whether used or not
+    P4INT64 Reserved();
+
+  private:
+    struct Chunk
+    {
+        Chunk* next;
+        int size;
+        int used;
+    };
+
+    Chunk* NewChunk( int size );
+    char* Data( Chunk* c ) { return (char*)( c + 1 ); }
+
+  private:
+    Chunk* chunks; // most recent first; the last is the initial chunk, if any
+    int chunkSize;
+    P4INT64 used;
+    P4INT64 highWater;
+};
+
+//
+// A StrDict whose keys and values live in a P4GoArena. Like the arena,
+// it never frees anything: removing or replacing a value just leaves the
+// old copy behind until the arena is reset. Given a key table, keys are
+// interned rather than copied, and each entry carries its key's ID.
+// Lookups are a linear scan until the dict gets wide (filelog and
+// describe records can have thousands of keys), when it builds itself a
+// hash index, also in the arena.
+//
+
+class P4GoArenaDict : public StrDict
+{
+  public:
+    P4GoArenaDict( P4GoArena* a, P4GoKeyTable* k = 0 );
+
+    // Add a variable known not to be present already; cheaper than
+    // SetVar(), which has to look for an existing entry first.
+    void Append( const StrPtr& var, const StrPtr& val );
+
+    int Count() { return count; }
+
+    // The interned ID of the x'th key, or -1 without a key table
+    int KeyId( int x ) { return ids ? ids[x] : -1; }
+
+  protected:
+    StrPtr* VGetVar( const StrPtr& var );
+    void VSetVar( const StrPtr& var, const StrPtr& val );
+    void VRemoveVar( const StrPtr& var );
+    int VGetVarX( int x, StrRef& var, StrRef& val );
+    void VClear() { count = 0; Unindex(); }
+
+  private:
+    void Grow();
+    int Find( const StrPtr& var );
+    void Unindex();
+
+  private:
+    P4GoArena* arena;
+    P4GoKeyTable* keys;
+    StrRef* vars;
+    StrRef* vals;
+    int* ids;
+    int count;
+    int max;
+
+    // Entries 0 to indexed - 1 are in the index, if there is one
+    P4GoHashIndex* index;
+    int indexed;
+};
@@ -99,6 +99,12 @@ cbHandleSpec( void* handler, P4GoSpecData* d )
     return goCallHandleSpecFunction( handler, d );
 }
 
+int
+cbStream( void* stream, char* d, int len )
+{
+    return goCallStreamFunction( stream, d, len );
+}
+
 int
 cbSSOAuthorize( void* handler, StrDict* d, int l, char** r )
 {
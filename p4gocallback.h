@@ -49,6 +49,9 @@ cbHandleText( void* handler, char* d );
 int
 cbHandleTrack( void* handler, char* d );
 
+int
+cbStream( void* stream, char* d, int len );
+
 int
 cbSSOAuthorize( void* handler, StrDict* d, int l, char** r );
 
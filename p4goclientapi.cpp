@@ -25,6 +25,10 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 *******************************************************************************/
 
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
 #include <p4/clientapi.h>
 #include <p4/strtable.h>
 #include <p4/vararray.h>
@@ -35,10 +39,29 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <p4/ignore.h>
 #include <p4/debug.h>
 #include "p4gospecmgr.h"
+#include "p4goarena.h"
+#include "p4gohashindex.h"
+#include "p4gokeytable.h"
 #include "p4goresult.h"
 #include "p4gomergedata.h"
+#include "p4gometrics.h"
+#include "p4gotrack.h"
+#include "p4gotrace.h"
 #include "p4goclientuser.h"
 #include "p4goclientapi.h"
+#include "p4gotransfer.h"
+
+//
+// Commands that only read, so that running one again after a lost
+// connection does no harm.
+//
+
+static const char* defaultIdempotent[] = {
+    "changes", "clients", "counters", "depots", "describe", "diff2",
+    "dirs", "filelog", "files", "fixes", "fstat", "groups", "info",
+    "jobs", "labels", "opened", "print", "sizes", "streams", "users",
+    0
+};
 
 P4GoClientApi::P4GoClientApi()
   : ui( &specMgr )
@@ -50,13 +73,33 @@ P4GoClientApi::P4GoClientApi()
     maxResults = 0;
     maxScanRows = 0;
     maxLockTime = 0;
+    pipelineWindow = 64;
+    reconnectRetries = 0;
+    reconnectDelay = 0;
+    reconnectMaxDelay = 0;
+    lost = 0;
+    cutOff = 0;
+    batch = 0;
+    batchMeters = 0;
+    batchCount = 0;
     InitFlags();
     apiLevel = atoi( P4Tag::l_client );
     enviro = new Enviro;
     prog = "Unnamed P4Go program";
+    protocol = new StrBufDict;
 
-    client.SetProtocol( "specstring", "" );
+    SetProtocol( "specstring", "" );
     client.SetBreak( &ui );
+    ui.SetMeter( &meter );
+    trackTotal = new P4GoTrack;
+    trace = new P4GoTrace;
+    ui.SetTrace( trace );
+    transfer = new P4GoTransfer( this );
+    ui.SetTransfer( transfer );
+
+    idempotent = new StrBufDict;
+    for( const char** c = defaultIdempotent; *c; c++ )
+        idempotent->SetVar( *c, "" );
 
     //
     // Load any P4CONFIG file
@@ -76,6 +119,12 @@ P4GoClientApi::~P4GoClientApi()
         client.Final( &e );
         // Ignore errors
     }
+    ClearBatch();
+    delete transfer;
+    delete protocol;
+    delete idempotent;
+    delete trackTotal;
+    delete trace;
     delete enviro;
 }
 
@@ -118,18 +167,21 @@ P4GoClientApi::SetApiLevel( int level )
     StrBuf b;
     b << level;
     apiLevel = level;
-    client.SetProtocol( "api", b.Text() );
+    SetProtocol( "api", b.Text() );
     ui.SetApiLevel( level );
 }
 
-int
-P4GoClientApi::SetCharset( const char* c, Error* e )
+//
+// Set up a client's charset and translation. Used for our connection, and
+// for those of the workers of a parallel transfer, so that they translate
+// file content as we would.
+//
+
+static int
+ApplyCharset( ClientApi& client, const char* c, Error* e )
 {
     StrRef cs_none( "none" );
 
-    if( debug > 0 )
-        fprintf( stderr, "[P4] Setting charset: %s\n", c );
-
     if( c && cs_none != c ) {
         CharSetApi::CharSet cs = CharSetApi::Lookup( c );
         if( cs < 0 ) {
@@ -147,6 +199,18 @@ P4GoClientApi::SetCharset( const char* c, Error* e )
     return 1;
 }
 
+int
+P4GoClientApi::SetCharset( const char* c, Error* e )
+{
+    trace->Record( TE_CHARSET );
+
+    if( !ApplyCharset( client, c, e ) )
+        return 0;
+
+    charset = c ? c : "none";
+    return 1;
+}
+
 void
 P4GoClientApi::SetCwd( const char* c )
 {
@@ -214,8 +278,10 @@ void
 P4GoClientApi::SetDebug( int d )
 {
     debug = d;
-    ui.SetDebug( d );
-    specMgr.SetDebug( d );
+
+    // Any level of debugging turns tracing on, if it isn't already
+    if( debug > 0 && !trace->GetSize() )
+        trace->SetSize( 256 );
 
     if( debug > 8 )
         p4debug.SetLevel( "rpc=5" );
@@ -238,6 +304,7 @@ void
 P4GoClientApi::SetProtocol( const char* var, const char* val )
 {
     client.SetProtocol( var, val );
+    protocol->ReplaceVar( var, val );
 }
 
 void
@@ -274,15 +341,14 @@ P4GoClientApi::SetEnv( const char* var, const char* val, Error* e )
 int
 P4GoClientApi::Connect( Error* e )
 {
-    if( debug > 0 )
-        fprintf( stderr, "[P4] Connecting to Perforce\n" );
-
     if( IsConnected() ) {
         e->Set(E_WARN, "P4#connect - Perforce client already connected!" );
         return 1;
     }
 
-    return ConnectOrReconnect( e );
+    int ok = ConnectOrReconnect( e );
+    trace->Record( TE_CONNECT, ok );
+    return ok;
 }
 
 int
@@ -300,26 +366,121 @@ P4GoClientApi::ConnectOrReconnect( Error* e )
     if( e->Test() )
         return 0;
 
-    // If a handler is defined, reset the break functionality
-    // for the KeepAlive function
+    specMgr.SetServer( client.GetPort() );
 
-    if( ui.GetHandler() != NULL )
-    {
-        client.SetBreak( &ui );
-    }
+    // Reset the break functionality for the KeepAlive function, which
+    // is how handlers, streams and cancellation stop a command
+    client.SetBreak( &ui );
     
     SetConnected();
+    lost = 0;
     return 1;
 }
 
+//
+// Make the connection again, as the reconnect policy allows. attempt
+// counts the tries made for the command being run, so that retries of
+// the command and of the connection share the one budget.
+//
+
+int
+P4GoClientApi::Reconnect( int& attempt )
+{
+    static thread_local std::minstd_rand jitter( std::random_device{}() );
+
+    while( attempt < reconnectRetries && ui.IsAlive() ) {
+        long delay = reconnectDelay;
+        for( int i = 0; i < attempt && delay < reconnectMaxDelay; i++ )
+            delay *= 2;
+        if( delay > reconnectMaxDelay )
+            delay = reconnectMaxDelay;
+        if( delay > 1 )
+            delay -= jitter() % ( delay / 2 + 1 );
+        attempt++;
+
+        trace->Record( TE_RECONNECT, attempt, delay );
+
+        // Wait in short steps, so that a cancellation isn't held up
+        auto until = std::chrono::steady_clock::now() +
+                     std::chrono::milliseconds( delay );
+        while( ui.IsAlive() && std::chrono::steady_clock::now() < until )
+            std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+        if( !ui.IsAlive() )
+            break;
+
+        Error e;
+        if( IsConnected() ) {
+            client.Final( &e );
+            e.Clear();
+        }
+        if( ConnectOrReconnect( &e ) ) {
+            meter.Reconnected();
+            return 1;
+        }
+    }
+
+    // Keep trying with the commands to come
+    if( reconnectRetries )
+        lost = 1;
+    return 0;
+}
+
+//
+// Whether to run a command again after it lost its connection. Only a
+// command whose output hasn't already gone to a handler or a stream, and
+// that does no harm run twice, is retried; the output of the attempt that
+// failed is thrown away.
+//
+
+int
+P4GoClientApi::Retry( const char* cmd, int& attempt )
+{
+    if( !client.Dropped() || !ui.IsAlive() )
+        return 0;
+
+    if( !IsIdempotent( cmd ) || ui.GetHandler() || ui.GetStream() )
+        return 0;
+
+    if( !Reconnect( attempt ) )
+        return 0;
+
+    ui.Reset();
+    return 1;
+}
+
+void
+P4GoClientApi::SetReconnect( int retries, int delay, int maxDelay )
+{
+    reconnectRetries = retries > 0 ? retries : 0;
+    reconnectDelay = delay > 0 ? delay : 0;
+    reconnectMaxDelay = maxDelay > reconnectDelay ? maxDelay : reconnectDelay;
+}
+
+void
+P4GoClientApi::SetIdempotent( const char* cmd, int i )
+{
+    if( i )
+        idempotent->SetVar( cmd, "" );
+    else
+        idempotent->RemoveVar( cmd );
+}
+
+int
+P4GoClientApi::IsIdempotent( const char* cmd )
+{
+    return idempotent->GetVar( cmd ) != 0;
+}
+
 //
 // Disconnect session
 //
 int
 P4GoClientApi::Disconnect( Error* e )
 {
-    if( debug > 0 )
-        fprintf( stderr, "[P4] Disconnect\n" );
+    trace->Record( TE_DISCONNECT );
+
+    // Disconnecting on purpose ends any attempt to reconnect
+    lost = 0;
 
     if( !IsConnected()) {
         e->Set(E_WARN,  "P4#disconnect - not connected" );
@@ -346,6 +507,12 @@ P4GoClientApi::Connected()
 {
     if( IsConnected() && !client.Dropped() )
         return 1;
+
+    // Under a reconnect policy, a lost connection is made again
+    if( ( lost || IsConnected() ) && reconnectRetries ) {
+        int attempt = 0;
+        return Reconnect( attempt );
+    }
     else if( IsConnected() )
     {
         Error e;
@@ -453,16 +620,179 @@ P4GoClientApi::IsIgnored( const char* path )
 P4GoResults*
 P4GoClientApi::Run( const char* cmd, int argc, char* const* argv, Error* e )
 {
-    // Save the entire command string for our error messages. Makes it
-    // easy to see where a script has gone wrong.
-    StrBuf cmdString;
-    cmdString << "\"p4 " << cmd;
-    for( int i = 0; i < argc; i++ )
-        cmdString << " " << argv[i];
-    cmdString << "\"";
+    if( !StartRun( cmd, argc, argv, e ) )
+        return 0;
+
+    int attempt = 0;
+    do
+        RunCmd( cmd, &ui, argc, argv );
+    while( Retry( cmd, attempt ) );
+
+    EndRun( e );
+
+    return ui.GetResults();
+}
+
+int
+P4GoClientApi::RunBatch( int count,
+                         char* const* cmds,
+                         const int* argcs,
+                         char* const* argv,
+                         Error* e )
+{
+    if( !StartRun( "batch", 0, 0, e ) )
+        return 0;
+
+    batch = new P4GoClientUser*[count];
+    batchMeters = new P4GoMeter[count];
+
+    //
+    // RunTag() only sends the command; the output is read, and dispatched
+    // to the UI each command was tagged with, by WaitTag(). Waiting after
+    // every window's worth keeps the number in flight bounded.
+    //
+    char* const* args = argv;
+    for( int i = 0; i < count; i++ ) {
+        if( !ui.IsAlive() || client.Dropped() )
+            break;
+
+        // Each command is timed from when it's sent to when it finishes
+        P4GoMeter* m = &batchMeters[batchCount];
+        m->SetParent( &meter );
+        m->Start();
+
+        P4GoClientUser* sink = NewSink( cmds[i], m );
+        batch[batchCount++] = sink;
+
+        m->Sent();
+        PrepareCmd( sink );
+        client.SetArgv( argcs[i], args );
+        client.RunTag( cmds[i], sink );
+        args += argcs[i];
+
+        if( ( i + 1 ) % pipelineWindow == 0 )
+            client.WaitTag();
+    }
+    client.WaitTag();
+    ReadProtocol();
+
+    // Commands cut off by a dropped connection never finished
+    for( int i = 0; i < batchCount; i++ )
+        if( batchMeters[i].Running() )
+            batchMeters[i].End();
+
+    EndRun( e );
+    return batchCount;
+}
+
+P4GoResults*
+P4GoClientApi::BatchResults( int i )
+{
+    if( i < 0 || i >= batchCount )
+        return 0;
+    return batch[i]->GetResults();
+}
+
+const P4GoMetrics*
+P4GoClientApi::BatchMetrics( int i )
+{
+    if( i < 0 || i >= batchCount )
+        return 0;
+    return &batchMeters[i].Last();
+}
+
+P4GoTrack*
+P4GoClientApi::BatchTrackData( int i )
+{
+    if( i < 0 || i >= batchCount )
+        return 0;
+    return batch[i]->GetTrackData();
+}
 
-    if( debug > 0 )
-        fprintf( stderr, "[P4] Executing %s\n", cmdString.Text() );
+//
+// A UI for one command of a batch, set up as ours is but recording into
+// a meter of its own. A batch may be thousands of small commands, so each
+// starts with a small arena.
+//
+
+P4GoClientUser*
+P4GoClientApi::NewSink( const char* cmd, P4GoMeter* m )
+{
+    P4GoClientUser* sink = new P4GoClientUser( &specMgr );
+
+    sink->SetTrace( trace );
+    sink->SetApiLevel( apiLevel );
+    sink->SetTrack( IsTrackMode() );
+    sink->SetCommand( cmd );
+    sink->SetMeter( m );
+    sink->SetTransfer( transfer );
+    sink->GetResults()->Arena()->SetChunkSize( 4096 );
+    sink->Reset();
+    return sink;
+}
+
+//
+// The connection of a worker of a parallel transfer, set up as ours is:
+// the same settings, charset and translation, protocol, and program name
+// and version. Called on the thread running the command, before the
+// workers start.
+//
+
+int
+P4GoClientApi::SetupWorker( ClientApi& worker, Error* e )
+{
+    worker.SetPort( &client.GetPort() );
+    worker.SetUser( &client.GetUser() );
+    worker.SetClient( &client.GetClient() );
+    worker.SetCwd( &client.GetCwd() );
+    worker.SetHost( &client.GetHost() );
+    if( client.GetPassword().Length() )
+        worker.SetPassword( &client.GetPassword() );
+    if( GetTicketFile().Length() )
+        worker.SetTicketFile( GetTicketFile().Text() );
+    if( GetTrustFile().Length() )
+        worker.SetTrustFile( GetTrustFile().Text() );
+
+    if( charset.Length() && !ApplyCharset( worker, charset.Text(), e ) )
+        return 0;
+
+    StrRef var, val;
+    for( int i = 0; protocol->GetVar( i, var, val ); i++ )
+        worker.SetProtocol( var.Text(), val.Text() );
+
+    worker.SetProg( &prog );
+    if( version.Length() )
+        worker.SetVersion( &version );
+    return 1;
+}
+
+void
+P4GoClientApi::ClearBatch()
+{
+    for( int i = 0; i < batchCount; i++ )
+        delete batch[i];
+    delete[] batch;
+    delete[] batchMeters;
+    batch = 0;
+    batchMeters = 0;
+    batchCount = 0;
+}
+
+//
+// The bookends of a run: checking that we can run a command at all and
+// resetting the UI for it, then delivering what's left of its output and
+// recovering the connection if it was broken off.
+//
+
+int
+P4GoClientApi::StartRun( const char* cmd,
+                         int argc,
+                         char* const* argv,
+                         Error* e )
+{
+    trace->SetCommand( cmd );
+    trace->Record( TE_RUN, 0, argc );
+    cutOff = 0;
 
     if( depth ) {
         e->Set(E_WARN, "P4#run - Can't execute nested Perforce commands." );
@@ -471,6 +801,15 @@ P4GoClientApi::Run( const char* cmd, int argc, char* const* argv, Error* e )
 
     // Clear out any results from the previous command
     ui.Reset();
+    ClearBatch();
+    meter.Start();
+
+    // A connection lost by an earlier command is made again before this
+    // one is sent, if the reconnect policy allows.
+    if( ( lost || ( IsConnected() && client.Dropped() ) ) && ui.IsAlive() ) {
+        int attempt = 0;
+        Reconnect( attempt );
+    }
 
     if( !IsConnected() && exceptionLevel )
         e->Set( E_FAILED, "P4#run - Not connected to a Perforce Server." );
@@ -482,19 +821,36 @@ P4GoClientApi::Run( const char* cmd, int argc, char* const* argv, Error* e )
     ui.SetCommand( cmd );
 
     depth++;
-    RunCmd( cmd, &ui, argc, argv );
+    return 1;
+}
+
+void
+P4GoClientApi::EndRun( Error* e )
+{
+    ui.Flush( true );
+    meter.End();
     depth--;
 
-    if( ui.GetHandler() != NULL ) {
-        if( client.Dropped() && !ui.IsAlive() ) {
-            Disconnect( e );
-            ConnectOrReconnect( e );
-        }
+    long long records = 0;
+    for( int i = 0; i < 6; i++ )
+        records += meter.Last().records[i];
+    trace->Record( TE_END, 0, records );
+
+    // A batch's track output went to its commands' UIs; gather it up
+    for( int i = 0; i < batchCount; i++ )
+        GetTrackData()->Add( *batch[i]->GetTrackData() );
+    trackTotal->Add( *GetTrackData() );
+
+    // A cancellation that arrives once the command has finished doesn't
+    // drop the connection, so only a dropped one means it was cut off
+    cutOff = client.Dropped() && ui.Cancelled();
+
+    // A command stopped by a handler, a stream or a cancellation leaves
+    // the connection dropped; make a fresh one for the next command.
+    if( client.Dropped() && !ui.IsAlive() ) {
+        Disconnect( e );
+        ConnectOrReconnect( e );
     }
-
-    P4GoResults* results = ui.GetResults();
-
-    return results;
 }
 
 void
@@ -502,6 +858,21 @@ P4GoClientApi::RunCmd( const char* cmd,
                        ClientUser* ui,
                        int argc,
                        char* const* argv )
+{
+    meter.Sent();
+    PrepareCmd( ui );
+    client.SetArgv( argc, argv );
+    client.Run( cmd, ui );
+    ReadProtocol();
+}
+
+//
+// Set the variables that go with every command. The client clears them
+// once a command has been sent, so a pipelined run sets them every time.
+//
+
+void
+P4GoClientApi::PrepareCmd( ClientUser* ui )
 {
     client.SetProg( &prog );
     if( version.Length() )
@@ -527,10 +898,11 @@ P4GoClientApi::RunCmd( const char* cmd,
     //	If progress is set, set progress var.
     if( ((P4GoClientUser*)ui)->GetProgress() != NULL )
         client.SetVar( P4Tag::v_progress, 1 );
+}
 
-    client.SetArgv( argc, argv );
-    client.Run( cmd, ui );
-
+void
+P4GoClientApi::ReadProtocol()
+{
     // Can only read the protocol block *after* a command has been run.
     // Do this once only.
     if( !IsCmdRun() ) {
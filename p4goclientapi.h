@@ -26,6 +26,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 *******************************************************************************/
 
 class Enviro;
+class P4GoTrack;
+class P4GoTrace;
+class P4GoTransfer;
 
 class P4GoClientApi
 {
@@ -75,6 +78,25 @@ class P4GoClientApi
 
     void SetMaxLockTime( int v ) { maxLockTime = v; }
 
+    // How many commands RunBatch() sends before waiting for their output
+    void SetPipelineWindow( int w ) { pipelineWindow = w > 0 ? w : 1; }
+
+    int GetPipelineWindow() { return pipelineWindow; }
+
+    //
+    // Reconnect policy. With retries set, a connection found dropped when
+    // a command is run is made again first, and an idempotent command that
+    // loses its connection part way through is run again on a new one.
+    // Each attempt waits twice as long as the one before, starting from
+    // delay and going up to maxDelay milliseconds, less a random part of
+    // up to half so that many clients don't all come back at once.
+    //
+    void SetReconnect( int retries, int delay, int maxDelay );
+
+    // Commands that are safe to run again; by default, the common reads
+    void SetIdempotent( const char* cmd, int idempotent );
+    int IsIdempotent( const char* cmd );
+
     int SetEnv( const char* var, const char* val, Error* e );
 
     void SetLanguage( const char* l ) { client.SetLanguage( l ); }
@@ -153,6 +175,35 @@ class P4GoClientApi
     // Executing commands.
     P4GoResults* Run( const char* cmd, int argc, char* const* argv, Error* e );
 
+    //
+    // Run a batch of independent commands, pipelined so that the round
+    // trips overlap, with each command's output collected into its own
+    // result set. cmds holds the commands and argcs how many arguments
+    // each takes from argv, one command after another. Returns the number
+    // of commands sent, which is short of count if the connection drops.
+    // The batch's results last until the next command is run.
+    //
+    int RunBatch( int count,
+                  char* const* cmds,
+                  const int* argcs,
+                  char* const* argv,
+                  Error* e );
+
+    int BatchCount() { return batchCount; }
+
+    // Cancel the running command; safe to call from any thread
+    void SetCancelled( int c ) { ui.SetCancelled( c ); }
+
+    // Was the last run cut off by SetCancelled(), rather than finishing
+    // before the cancellation reached it?
+    int WasCancelled() { return cutOff; }
+    P4GoResults* BatchResults( int i );
+
+    // The metrics and track data of one command of the last RunBatch(),
+    // or null if there is no such command
+    const P4GoMetrics* BatchMetrics( int i );
+    P4GoTrack* BatchTrackData( int i );
+
     void ResetInput() { ui.ResetInput(); }
 
     void AppendInput( char* input ) { ui.AppendInput( input ); }
@@ -160,6 +211,19 @@ class P4GoClientApi
     // Result handling
     P4GoResults* GetResults() { return ui.GetResults(); }
 
+    // What the last run cost, and what all of them have since the reset
+    const P4GoMetrics& GetMetrics() { return meter.Last(); }
+
+    const P4GoMetrics& GetTotalMetrics() { return meter.Total(); }
+
+    void ResetMetrics() { meter.ResetTotal(); }
+
+    // The -Ztrack figures of the last run, and of all of them since the
+    // reset
+    P4GoTrack* GetTrackData() { return ui.GetTrackData(); }
+
+    P4GoTrack* GetTrackTotal() { return trackTotal; }
+
     // Spec parsing
     P4GoSpecData* ParseSpec( const char* type, const char* form, Error* e );
     char* FormatSpec( const char* type, P4GoSpecData* spec, Error* e );
@@ -179,20 +243,32 @@ class P4GoClientApi
     //
     // Debugging support. Debug levels are:
     //
-    //     1:	Debugs commands being executed
-    //     2:	Debug UI method calls
-    //     3:	Show garbage collection
+    //     1:	Turn on the trace ring, if it isn't already
+    //     9:	Debug RPC traffic
+    //     11:	Debug SSL
     //
     int GetDebug() { return debug; }
 
     void SetDebug( int d );
 
+    // The trace ring: see p4gotrace.h. Off until given a size.
+    void SetTraceSize( int size ) { trace->SetSize( size ); }
+
+    P4GoTrace* GetTrace() { return trace; }
+
     // Handler support
 
     void SetHandler( P4GoHandler* handler ) { ui.SetHandler( handler ); }
 
     P4GoHandler* GetHandler() { return ui.GetHandler(); }
 
+    P4GoFilter* GetFilter() { return ui.GetFilter(); }
+
+    // Streaming support
+    void SetStream( P4GoStream* stream ) { ui.SetStream( stream ); }
+
+    P4GoStream* GetStream() { return ui.GetStream(); }
+
     //	Progress API support
     void SetProgress( P4GoProgress* progress ) { ui.SetProgress( progress ); }
 
@@ -212,11 +288,23 @@ class P4GoClientApi
 
     P4GoResolveHandler* GetResolveHandler() { return ui.GetResolveHandler(); }
 
+    // Set up a worker connection for a parallel transfer
+    int SetupWorker( ClientApi& worker, Error* e );
 
   private:
+    int StartRun( const char* cmd, int argc, char* const* argv, Error* e );
+    void EndRun( Error* e );
+
     void RunCmd( const char* cmd, ClientUser* ui, int argc, char* const* argv );
+    void PrepareCmd( ClientUser* ui );
+    void ReadProtocol();
+
+    P4GoClientUser* NewSink( const char* cmd, P4GoMeter* m );
+    void ClearBatch();
 
     int ConnectOrReconnect( Error *e ); // internal connect method
+    int Reconnect( int& attempt );
+    int Retry( const char* cmd, int& attempt );
 
     enum
     {
@@ -289,10 +377,15 @@ class P4GoClientApi
   private:
     ClientApi client;
     P4GoClientUser ui;
+    P4GoMeter meter;
+    P4GoTrack* trackTotal;
+    P4GoTrace* trace;
     Enviro* enviro;
     P4GoSpecMgr specMgr;
+    P4GoTransfer* transfer;
     StrBuf prog;
     StrBuf version;
+    StrBuf charset;
     StrBuf ticketFile;
     StrBuf trustFile;
     int depth;
@@ -304,4 +397,17 @@ class P4GoClientApi
     int maxResults;
     int maxScanRows;
     int maxLockTime;
+    int pipelineWindow;
+    int reconnectRetries;
+    int reconnectDelay;
+    int reconnectMaxDelay;
+    int lost; // dropped, and not yet made again
+    int cutOff; // the last run was stopped by SetCancelled()
+    StrBufDict* idempotent;
+    StrBufDict* protocol; // as set, for worker connections
+
+    // A result sink, and a meter, for each command of the last RunBatch()
+    P4GoClientUser** batch;
+    P4GoMeter* batchMeters;
+    int batchCount;
 };
@@ -25,6 +25,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 *******************************************************************************/
 
+#include <atomic>
+#include <chrono>
 #include <p4/clientapi.h>
 #include <p4/clientprog.h>
 #include <p4/i18napi.h>
@@ -36,9 +38,15 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <p4/spec.h>
 #include "p4gomergedata.h"
 #include "p4gospecmgr.h"
+#include "p4goarena.h"
+#include "p4gohashindex.h"
+#include "p4gokeytable.h"
 #include "p4goresult.h"
+#include "p4gofilter.h"
+#include "p4gometrics.h"
+#include "p4gotrack.h"
+#include "p4gotrace.h"
 #include "p4goclientuser.h"
-#include "p4godebug.h"
 
 //
 // Progress callbacks
@@ -47,7 +55,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 class P4GoClientProgress : public ClientProgress
 {
   public:
-    P4GoClientProgress( P4GoProgress* prog, int t );
+    P4GoClientProgress( P4GoClientUser* ui, int t );
     virtual ~P4GoClientProgress();
 
   public:
@@ -57,13 +65,18 @@ class P4GoClientProgress : public ClientProgress
     void Done( int f );
 
   private:
+    P4GoClientUser* ui;
     P4GoProgress* progress;
 };
 
-P4GoClientProgress::P4GoClientProgress( P4GoProgress* prog, int type )
+P4GoClientProgress::P4GoClientProgress( P4GoClientUser* u, int type )
 {
-    progress = prog;
+    ui = u;
+    progress = ui->GetProgress();
+
+    long long t = P4GoMeter::Now();
     progress->Init( type );
+    ui->Crossed( t );
 }
 
 P4GoClientProgress::~P4GoClientProgress() {}
@@ -71,26 +84,34 @@ P4GoClientProgress::~P4GoClientProgress() {}
 void
 P4GoClientProgress::Description( const StrPtr* desc, int units )
 {
+    long long t = P4GoMeter::Now();
     progress->Description( desc, units );
+    ui->Crossed( t );
 }
 
 void
 P4GoClientProgress::Total( long total )
 {
+    long long t = P4GoMeter::Now();
     progress->Total( total );
+    ui->Crossed( t );
 }
 
 int
 P4GoClientProgress::Update( long position )
 {
+    long long t = P4GoMeter::Now();
     progress->Update( position );
+    ui->Crossed( t );
     return 0;
 }
 
 void
 P4GoClientProgress::Done( int fail )
 {
+    long long t = P4GoMeter::Now();
     progress->Done( fail );
+    ui->Crossed( t );
 }
 
 P4GoProgress::P4GoProgress( cbInit_t cbInit,
@@ -187,6 +208,54 @@ P4GoHandler::HandleSpec( P4GoSpecData* spec )
     return cbHandleSpec( this, spec );
 }
 
+static P4INT64
+NowMillis()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch() )
+      .count();
+}
+
+P4GoStream::P4GoStream( cbStream_t cbStream )
+  : cbStream( cbStream )
+  , maxRecords( 1 )
+  , maxBytes( 0 )
+  , maxMillis( 0 )
+  , started( 0 )
+{
+}
+
+int
+P4GoStream::Deliver( const StrPtr& buf )
+{
+    return cbStream( this, buf.Text(), buf.Length() );
+}
+
+void
+P4GoStream::SetBatch( int records, int bytes, int millis )
+{
+    maxRecords = records;
+    maxBytes = bytes;
+    maxMillis = millis;
+}
+
+void
+P4GoStream::Begin()
+{
+    if( maxMillis )
+        started = NowMillis();
+}
+
+bool
+P4GoStream::Ready( int records, P4INT64 bytes )
+{
+    if( maxRecords && records >= maxRecords )
+        return true;
+    if( maxBytes && bytes >= maxBytes )
+        return true;
+    return maxMillis && NowMillis() - started >= maxMillis;
+}
+
 P4GoSSOHandler::P4GoSSOHandler( cbSSOAuthorize_t cbSSOAuthorize )
   : cbSSOAuthorize( cbSSOAuthorize )
 {
@@ -219,27 +288,48 @@ P4GoResolveHandler::Resolve( P4GoMergeData* m )
 P4GoClientUser::P4GoClientUser( P4GoSpecMgr* s )
 {
     specMgr = s;
-    debug = 0;
     apiLevel = atoi( P4Tag::l_client );
     input = new StrArray();
     handler = 0;
+    filter = new P4GoFilter;
+    stream = 0;
+    batchStart = 0;
     resolveHandler = 0;
     progress = 0;
     alive = 1;
+    cancelled = 0;
     track = false;
+    meter = 0;
+    trace = 0;
+    tracked = new P4GoTrack;
 }
 
 P4GoClientUser::~P4GoClientUser()
 {
     delete input;
+    delete filter;
+    delete tracked;
+}
+
+void
+P4GoClientUser::Trace( int type, int arg, long long size )
+{
+    if( trace )
+        trace->Record( type, arg, size );
 }
 
 void
 P4GoClientUser::Reset()
 {
     results.Reset();
+    tracked->Clear();
     // Leave input alone.
 
+    batchStart = 0;
+    results.Arena()->Mark( batchMark );
+    if( stream )
+        stream->Begin();
+
     alive = 1;
 }
 
@@ -254,34 +344,64 @@ void
 P4GoClientUser::Finished()
 {
     // Reset input coz we should be done with it now.
-    if( P4GODB_CALLS && input->Count() )
-        fprintf( stderr, "[P4] Cleaning up saved input\n" );
-
     input->Clear();
+
+    // A command of a batch has a meter of its own, which stops here
+    if( meter && meter->Parent() )
+        meter->End();
 }
 
 /*
  * Handling of output
  */
 
+void
+P4GoClientUser::Flush( bool force )
+{
+    if( !stream )
+        return;
+
+    int n = results.Count() - batchStart;
+    if( !n )
+        return;
+
+    P4INT64 bytes = results.Arena()->Used() - batchMark.total;
+    if( !force && !stream->Ready( n, bytes ) )
+        return;
+
+    // Once cancelled, anything still arriving is just dropped
+    int ret = 2;
+    if( IsAlive() ) {
+        long long t = P4GoMeter::Now();
+        ret = stream->Deliver( results.Pack( batchStart ) );
+        Crossed( t );
+    }
+    Trace( TE_FLUSH, ret, n );
+
+    // As with the output handler, a batch that is reported is kept for
+    // Run() to return; otherwise it is released straight away.
+    if( ret != 0 )
+        results.Truncate( batchStart, batchMark );
+
+    batchStart = results.Count();
+    results.Arena()->Mark( batchMark );
+    stream->Begin();
+
+    if( ret == 2 )
+        alive = 0;
+}
+
 bool
 P4GoClientUser::CallOutputMethod( StrPtr data, bool binary )
 {
-    if( P4GODB_COMMANDS )
-        fprintf(
-          stderr, "[P4] CallOutputMethod(%s)\n", binary ? "binary" : "text" );
-
+    long long t = P4GoMeter::Now();
     int ret =
       binary ? handler->HandleBinary( data ) : handler->HandleText( data );
+    Crossed( t );
 
-    if( P4GODB_COMMANDS )
-        fprintf( stderr, "[P4] CallOutputMethod returned %d\n", ret );
-
-    if( ret == 2 ) {
-        if( P4GODB_COMMANDS )
-            fprintf( stderr, "[P4] CallOutputMethod cancelled\n" );
+    Trace( TE_HANDLER, ret );
+    if( ret == 2 )
         alive = 0;
-    }
 
     return ( ret == 0 );
 }
@@ -289,19 +409,13 @@ P4GoClientUser::CallOutputMethod( StrPtr data, bool binary )
 bool
 P4GoClientUser::CallOutputMethod( StrDict* data )
 {
-    if( P4GODB_COMMANDS )
-        fprintf( stderr, "[P4] CallOutputMethod(dict)\n" );
-
+    long long t = P4GoMeter::Now();
     int ret = handler->HandleStat( data );
+    Crossed( t );
 
-    if( P4GODB_COMMANDS )
-        fprintf( stderr, "[P4] CallOutputMethod returned %d\n", ret );
-
-    if( ret == 2 ) {
-        if( P4GODB_COMMANDS )
-            fprintf( stderr, "[P4] CallOutputMethod cancelled\n" );
+    Trace( TE_HANDLER, ret );
+    if( ret == 2 )
         alive = 0;
-    }
 
     return ( ret == 0 );
 }
@@ -309,19 +423,13 @@ P4GoClientUser::CallOutputMethod( StrDict* data )
 bool
 P4GoClientUser::CallOutputMethod( Error* e )
 {
-    if( P4GODB_COMMANDS )
-        fprintf( stderr, "[P4] CallOutputMethod(error)\n" );
-
+    long long t = P4GoMeter::Now();
     int ret = handler->HandleMessage( e );
+    Crossed( t );
 
-    if( P4GODB_COMMANDS )
-        fprintf( stderr, "[P4] CallOutputMethod returned %d\n", ret );
-
-    if( ret == 2 ) {
-        if( P4GODB_COMMANDS )
-            fprintf( stderr, "[P4] CallOutputMethod cancelled\n" );
+    Trace( TE_HANDLER, ret );
+    if( ret == 2 )
         alive = 0;
-    }
 
     return ( ret == 0 );
 }
@@ -329,19 +437,10 @@ P4GoClientUser::CallOutputMethod( Error* e )
 bool
 P4GoClientUser::CallOutputMethod( P4GoSpecData* data )
 {
-    if( P4GODB_COMMANDS )
-        fprintf( stderr, "[P4] CallOutputMethod(spec)\n" );
-
     int ret = 0; // handler->HandleSpec( data );
 
-    if( P4GODB_COMMANDS )
-        fprintf( stderr, "[P4] CallOutputMethod returned %d\n", ret );
-
-    if( ret == 2 ) {
-        if( P4GODB_COMMANDS )
-            fprintf( stderr, "[P4] CallOutputMethod cancelled\n" );
+    if( ret == 2 )
         alive = 0;
-    }
 
     return ( ret == 0 );
 }
@@ -349,41 +448,49 @@ P4GoClientUser::CallOutputMethod( P4GoSpecData* data )
 void
 P4GoClientUser::ProcessOutput( StrPtr data, bool binary )
 {
+    Received( binary ? BINARY : STRING, data.Length() );
     if( this->handler ) {
         if( CallOutputMethod( data, binary ) )
             results.AddOutput( data, binary );
     } else
         results.AddOutput( data, binary );
+    Flush();
 }
 
 void
-P4GoClientUser::ProcessOutput( StrDict* data )
+P4GoClientUser::ProcessOutput( P4GoArenaDict* data )
 {
+    Received( DICT );
     if( this->handler ) {
         if( CallOutputMethod( data ) )
             results.AddOutput( data );
     } else
         results.AddOutput( data );
+    Flush();
 }
 
 void
 P4GoClientUser::ProcessOutput( P4GoSpecData* data )
 {
+    Received( SPEC );
     if( this->handler ) {
         if( CallOutputMethod( data ) )
             results.AddOutput( data );
     } else
         results.AddOutput( data );
+    Flush();
 }
 
 void
 P4GoClientUser::ProcessMessage( Error* e )
 {
+    Received( ERROR );
     if( this->handler ) {
         if( CallOutputMethod( e ) )
             results.AddOutput( e );
     } else
         results.AddOutput( e );
+    Flush();
 }
 
 /*
@@ -395,16 +502,14 @@ P4GoClientUser::ProcessMessage( Error* e )
 void
 P4GoClientUser::OutputText( const char* data, int length )
 {
-    if( P4GODB_CALLS )
-        fprintf( stderr, "[P4] OutputText()\n" );
-    if( P4GODB_DATA )
-        fprintf( stderr, "... [%d]%*s\n", length, length, data );
+    Trace( TE_TEXT, 0, length );
     if( track && length > 4 && data[0] == '-' && data[1] == '-' &&
         data[2] == '-' && data[3] == ' ' ) {
         int p = 4;
         for( int i = 4; i < length; ++i ) {
             if( data[i] == '\n' ) {
                 if( i > p ) {
+                    Received( TRACK );
                     results.AddTrack( StrRef( data + p, i - p ) );
                     p = i + 5;
                 } else {
@@ -416,6 +521,19 @@ P4GoClientUser::OutputText( const char* data, int length )
                 }
             }
         }
+
+        // Now that it's known to be track data, parse it
+        int lines = 0;
+        p = 4;
+        for( int i = 4; i < length; ++i ) {
+            if( data[i] == '\n' ) {
+                tracked->Parse( StrRef( data + p, i - p ) );
+                p = i + 5;
+                lines++;
+            }
+        }
+        Trace( TE_TRACK, 0, lines );
+        Flush();
     } else
         ProcessOutput( StrRef( data, length ), false );
 }
@@ -423,30 +541,14 @@ P4GoClientUser::OutputText( const char* data, int length )
 void
 P4GoClientUser::Message( Error* e )
 {
-    if( P4GODB_CALLS )
-        fprintf( stderr, "[P4] Message()\n" );
-
-    if( P4GODB_DATA ) {
-        StrBuf t;
-        e->Fmt( t, EF_PLAIN );
-        fprintf( stderr, "... [%s] %s\n", e->FmtSeverity(), t.Text() );
-    }
-
+    Trace( TE_MESSAGE, e->GetSeverity() );
     ProcessMessage( e );
 }
 
 void
 P4GoClientUser::OutputBinary( const char* data, int length )
 {
-    if( P4GODB_CALLS )
-        fprintf( stderr, "[P4] OutputBinary()\n" );
-    if( P4GODB_DATA ) {
-        for( int l = 0; l < length; l++ ) {
-            if( l % 16 == 0 )
-                fprintf( stderr, "%s... ", l ? "\n" : "" );
-            fprintf( stderr, "%#hhx ", data[l] );
-        }
-    }
+    Trace( TE_BINARY, 0, length );
 
     //
     // Binary is just stored in a string. Since the char * version of
@@ -459,16 +561,7 @@ P4GoClientUser::OutputBinary( const char* data, int length )
 void
 P4GoClientUser::HandleError( Error* e )
 {
-    if( P4GODB_CALLS )
-        fprintf( stderr, "[P4] HandleError()\n" );
-
-    if( P4GODB_DATA ) {
-        StrBuf t;
-        e->Fmt( t, EF_PLAIN );
-
-        fprintf( stderr, "... [%s] %s\n", e->FmtSeverity(), t.Text() );
-    }
-
+    Trace( TE_ERROR, e->GetSeverity() );
     ProcessMessage( e );
 }
 
@@ -506,17 +599,14 @@ P4GoClientUser::OutputStat( StrDict* values )
         // 2000.1 -> 2005.1 server's handle tagged form output by supplying the
         // form as text in the 'data' variable. We need to convert it to a
         // dictionary using the supplied spec.
-        if( P4GODB_CALLS )
-            fprintf( stderr, "[P4] OutputStat() - parsing form\n" );
-
         // Parse the form. Use the ParseNoValid() interface to prevent
         // errors caused by the use of invalid defaults for select items in
         // jobspecs.
 
-        Spec s( spec->Text(), "", &e );
+        Spec* s = specMgr->GetSpec( cmd.Text(), &e );
 
-        if( !e.Test() )
-            s.ParseNoValid( data->Text(), &specData, &e );
+        if( s )
+            s->ParseNoValid( data->Text(), &specData, &e );
         if( e.Test() ) {
             HandleError( &e );
             return;
@@ -529,21 +619,25 @@ P4GoClientUser::OutputStat( StrDict* values )
     // object. Otherwise it's a plain hash.
     //
     if( isspec ) {
-        if( P4GODB_CALLS )
-            fprintf( stderr,
-                     "[P4] OutputStat() - Converting to P4::Spec object\n" );
-        ProcessOutput( specMgr->StrDictToSpec( dict, spec ) );
+        Trace( TE_SPEC );
+        ProcessOutput( specMgr->StrDictToSpec( cmd.Text(), dict ) );
     } else {
-        if( P4GODB_CALLS )
-            fprintf( stderr, "[P4] OutputStat() - Passing StrDict\n" );
-        StrBufDict* ndict = new StrBufDict();
+        if( filter->Active() && !filter->Accept( dict ) ) {
+            Trace( TE_FILTERED );
+            Received( DICT );
+            return;
+        }
+        Trace( TE_STAT );
+        P4GoArenaDict* ndict = results.NewDict();
         StrDictIterator* iter = dict->GetIterator();
         StrRef var, val;
         while( iter->Get( var, val ) ) {
             iter->Next();
             if( var == "specdef" || var == "func" || var == "specFormatted" )
                 continue;
-            ndict->SetVar( var, val );
+            if( !filter->Keep( var ) )
+                continue;
+            ndict->Append( var, val );
         }
         ProcessOutput( ndict );
     }
@@ -563,8 +657,7 @@ P4GoClientUser::Diff( FileSys* f1,
                       char* diffFlags,
                       Error* e )
 {
-    if( P4GODB_CALLS )
-        fprintf( stderr, "[P4] Diff() - comparing files\n" );
+    Trace( TE_DIFF );
 
     //
     // Duck binary files. Much the same as ClientUser::Diff, we just
@@ -632,14 +725,12 @@ P4GoClientUser::Diff( FileSys* f1,
 void
 P4GoClientUser::InputData( StrBuf* strbuf, Error* e )
 {
-    if( P4GODB_CALLS )
-        fprintf( stderr, "[P4] InputData(). Using supplied input\n" );
-
     strbuf->Clear();
     if( input->Count() ) {
         *strbuf = *input->Get( 0 );
         input->Remove( 0 );
     }
+    Trace( TE_INPUT, 0, strbuf->Length() );
 }
 
 /*
@@ -651,8 +742,7 @@ P4GoClientUser::InputData( StrBuf* strbuf, Error* e )
 void
 P4GoClientUser::Prompt( const StrPtr& msg, StrBuf& rsp, int noEcho, Error* e )
 {
-    if( P4GODB_CALLS )
-        fprintf( stderr, "[P4] Prompt(): %s\n", msg.Text() );
+    Trace( TE_PROMPT );
 
     InputData( &rsp, e );
 }
@@ -664,8 +754,7 @@ P4GoClientUser::Prompt( const StrPtr& msg, StrBuf& rsp, int noEcho, Error* e )
 int
 P4GoClientUser::Resolve( ClientMerge* m, Error* e )
 {
-    if( P4GODB_CALLS )
-        fprintf( stderr, "[P4] Resolve()\n" );
+    Trace( TE_RESOLVE );
 
     //
     // If no handler has been set, default to using the merger's resolve
@@ -674,14 +763,16 @@ P4GoClientUser::Resolve( ClientMerge* m, Error* e )
         return m->Resolve( e );
 
     P4GoMergeData md( this, m, 0 );
-    return resolveHandler->Resolve( &md );
+    long long t = P4GoMeter::Now();
+    int ret = resolveHandler->Resolve( &md );
+    Crossed( t );
+    return ret;
 }
 
 int
 P4GoClientUser::Resolve( ClientResolveA* m, int preview, Error* e )
 {
-    if( P4GODB_CALLS )
-        fprintf( stderr, "[P4] Resolve(Action)\n" );
+    Trace( TE_RESOLVE, 1 );
 
     //
     // If no resolveHandler has been set, default to using the merger's resolve
@@ -690,7 +781,10 @@ P4GoClientUser::Resolve( ClientResolveA* m, int preview, Error* e )
         return m->Resolve( 0, e );
 
     P4GoMergeData md( this, m, 0 );
-    return resolveHandler->Resolve( &md );
+    long long t = P4GoMeter::Now();
+    int ret = resolveHandler->Resolve( &md );
+    Crossed( t );
+    return ret;
 }
 
 /*
@@ -700,11 +794,10 @@ P4GoClientUser::Resolve( ClientResolveA* m, int preview, Error* e )
 ClientProgress*
 P4GoClientUser::CreateProgress( int type )
 {
-    if( P4GODB_CALLS )
-        fprintf( stderr, "[P4] CreateProgress()\n" );
+    Trace( TE_PROGRESS, type );
 
     if( progress ) {
-        return new P4GoClientProgress( progress, type );
+        return new P4GoClientProgress( this, type );
     }
     return 0;
 }
@@ -717,8 +810,6 @@ P4GoClientUser::CreateProgress( int type )
 int
 P4GoClientUser::ProgressIndicator()
 {
-    if( P4GODB_CALLS )
-        fprintf( stderr, "[P4] ProgressIndicator()\n" );
     return progress != NULL;
 }
 
@@ -731,18 +822,12 @@ P4GoClientUser::ProgressIndicator()
 void
 P4GoClientUser::ResetInput()
 {
-    if( P4GODB_CALLS )
-        fprintf( stderr, "[P4] ResetInput()\n" );
-
     input->Clear();
 }
 
 void
 P4GoClientUser::AppendInput( char* i )
 {
-    if( P4GODB_CALLS )
-        fprintf( stderr, "[P4] AppendInput()\n" );
-
     input->Put()->Set( i );
 }
 
@@ -754,8 +839,6 @@ P4GoClientUser::AppendInput( char* i )
 void
 P4GoClientUser::SetHandler( P4GoHandler* h )
 {
-    if( P4GODB_CALLS )
-        fprintf( stderr, "[P4] SetHandler()\n" );
     handler = h;
     alive = 1; // ensure that we don't drop out after the next call
 }
@@ -766,9 +849,6 @@ P4GoClientUser::SetHandler( P4GoHandler* h )
 void
 P4GoClientUser::SetProgress( P4GoProgress* p )
 {
-    if( P4GODB_CALLS )
-        fprintf( stderr, "[P4] SetProgress()\n" );
-
     progress = p;
     alive = 1;
 }
@@ -776,8 +856,6 @@ P4GoClientUser::SetProgress( P4GoProgress* p )
 void
 P4GoClientUser::SetSSOHandler( P4GoSSOHandler* h )
 {
-    if( P4GODB_CALLS )
-        fprintf( stderr, "[P4] SetSSOHandler()\n" );
     ClientUser::SetSSOHandler( h );
     alive = 1; // ensure that we don't drop out after the next call
 }
@@ -785,23 +863,17 @@ P4GoClientUser::SetSSOHandler( P4GoSSOHandler* h )
 P4GoSSOHandler*
 P4GoClientUser::GetSSOHandler()
 {
-    if( P4GODB_CALLS )
-        fprintf( stderr, "[P4] GetSSOHandler()\n" );
     return (P4GoSSOHandler*)ClientUser::GetSSOHandler();
 }
 
 void
 P4GoClientUser::SetResolveHandler( P4GoResolveHandler* h )
 {
-    if( P4GODB_CALLS )
-        fprintf( stderr, "[P4] SetResolveHandler()\n" );
     resolveHandler = h;
 }
 
 P4GoResolveHandler*
 P4GoClientUser::GetResolveHandler()
 {
-    if( P4GODB_CALLS )
-        fprintf( stderr, "[P4] GetResolveHandler()\n" );
     return resolveHandler;
 }
\ No newline at end of file
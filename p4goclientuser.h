@@ -26,7 +26,10 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 *******************************************************************************/
 
 class P4GoSpecMgr;
+class P4GoFilter;
 class ClientProgress;
+class P4GoTrack;
+class P4GoTrace;
 
 typedef void ( *cbInit_t )( void*, int );
 typedef void ( *cbDesc_t )( void*, char*, int );
@@ -88,6 +91,38 @@ class P4GoHandler
     cbHandleSpec_t cbHandleSpec;
 };
 
+typedef int ( *cbStream_t )( void*, char*, int );
+
+//
+// Streaming output: rather than being collected for the end of the
+// command, results are handed to Go as packed buffers as they arrive.
+// By default every result is delivered on its own; SetBatch() lets them
+// build up until there are enough records or bytes, or enough time has
+// passed since the last delivery. A zero limit is ignored.
+//
+
+class P4GoStream
+{
+  public:
+    P4GoStream( cbStream_t cbStream );
+    int Deliver( const StrPtr& buf );
+
+    void SetBatch( int records, int bytes, int millis );
+
+    // Start timing a new batch
+    void Begin();
+
+    // Is a batch of this size due for delivery?
+    bool Ready( int records, P4INT64 bytes );
+
+  private:
+    cbStream_t cbStream;
+    int maxRecords;
+    int maxBytes;
+    int maxMillis;
+    P4INT64 started;
+};
+
 typedef int ( *cbSSOAuthorize_t )( void*, StrDict* d, int l, char** result );
 
 class P4GoSSOHandler : public ClientSSO
@@ -153,24 +188,57 @@ class P4GoClientUser
 
     void SetTrack( bool t ) { track = t; }
 
+    // The -Ztrack figures of the command being run, parsed
+    P4GoTrack* GetTrackData() { return tracked; }
+
     P4GoResults* GetResults() { return &results; }
 
     int ErrorCount();
     void Reset();
 
-    // Debugging support
-    void SetDebug( int d ) { debug = d; }
+    // Tracing support. Events go to the trace ring, if there is one; the
+    // ring is shared with the API, and any worker connections.
+    void SetTrace( P4GoTrace* t ) { trace = t; }
+
+    P4GoTrace* GetTrace() { return trace; }
+
+    void Trace( int type, int arg = 0, long long size = 0 );
 
     // Handler support
     void SetHandler( P4GoHandler* handler );
 
     P4GoHandler* GetHandler() { return handler; }
 
+    // Filtering of tagged output
+    P4GoFilter* GetFilter() { return filter; }
+
+    // Streaming support
+    void SetStream( P4GoStream* s ) { stream = s; }
+
+    P4GoStream* GetStream() { return stream; }
+
+    // Pass pending results to the stream, if there is one, once a batch
+    // is due or when forced to at the end of the command.
+    void Flush( bool force = false );
+
     //	Progress API support
     void SetProgress( P4GoProgress* p );
 
     P4GoProgress* GetProgress() { return progress; }
 
+    // Metrics support. A UI with a meter records in it what it receives,
+    // and the calls it makes into Go: Crossed() is given the time, from
+    // P4GoMeter::Now(), that such a call started.
+    void SetMeter( P4GoMeter* m ) { meter = m; }
+
+    P4GoMeter* GetMeter() { return meter; }
+
+    void Crossed( long long since )
+    {
+        if( meter )
+            meter->Crossed( since );
+    }
+
     // SSO handler support
     void SetSSOHandler( P4GoSSOHandler* handler );
     P4GoSSOHandler* GetSSOHandler();
@@ -179,21 +247,36 @@ class P4GoClientUser
     void SetResolveHandler( P4GoResolveHandler* handler );
     P4GoResolveHandler* GetResolveHandler();
 
+    //
+    // Cancel the command being run. Unlike everything else here this may
+    // be called from any thread; the client notices the next time it
+    // checks IsAlive(), and drops the connection.
+    //
+    void SetCancelled( int c ) { cancelled.store( c ); }
+
+    int Cancelled() { return cancelled.load(); }
+
     // override from KeepAlive
-    virtual int IsAlive() { return alive; }
+    virtual int IsAlive() { return alive && !cancelled.load(); }
 
   private:
     void* MkMergeInfo( ClientMerge* m, StrPtr& hint );
     void* MkActionMergeInfo( ClientResolveA* m, StrPtr& hint );
     void ProcessMessage( Error* e );
     void ProcessOutput( StrPtr data, bool binary );
-    void ProcessOutput( StrDict* data );
+    void ProcessOutput( P4GoArenaDict* data );
     void ProcessOutput( P4GoSpecData* data );
     bool CallOutputMethod( StrPtr data, bool binary );
     bool CallOutputMethod( StrDict* data );
     bool CallOutputMethod( Error* e );
     bool CallOutputMethod( P4GoSpecData* e );
 
+    void Received( int type, int bytes = 0 )
+    {
+        if( meter )
+            meter->Received( type, bytes );
+    }
+
   private:
     StrBuf cmd;
     P4GoSpecMgr* specMgr;
@@ -201,9 +284,16 @@ class P4GoClientUser
     StrArray* input;
     P4GoResolveHandler* resolveHandler;
     P4GoHandler* handler;
+    P4GoFilter* filter;
+    P4GoStream* stream;
+    int batchStart;
+    P4GoArenaMark batchMark;
     P4GoProgress* progress;
-    int debug;
+    P4GoMeter* meter;
+    P4GoTrack* tracked;
+    P4GoTrace* trace;
     int apiLevel;
     int alive;
+    std::atomic<int> cancelled;
     bool track;
 };
\ No newline at end of file
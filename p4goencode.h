@@ -0,0 +1,109 @@
+/*******************************************************************************
+
+Copyright (c) 2024, Perforce Software, Inc.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+//
+// P4GoEncoder appends fixed-width little-endian integers and
+// length-prefixed strings to a StrBuf. The packed buffers it produces are
+// handed to Go in a single cgo call and walked by p4Decoder in p4.go, so
+// the two must be kept in step.
+//
+
+class P4GoEncoder
+{
+  public:
+    P4GoEncoder( StrBuf& b ) : buf( b ) {}
+
+    void PutByte( int v ) { buf.Extend( (char)v ); }
+
+    void PutU32( unsigned int v )
+    {
+        char b[4];
+        b[0] = (char)( v & 0xff );
+        b[1] = (char)( ( v >> 8 ) & 0xff );
+        b[2] = (char)( ( v >> 16 ) & 0xff );
+        b[3] = (char)( ( v >> 24 ) & 0xff );
+        buf.Extend( b, 4 );
+    }
+
+    void PutI64( P4INT64 v )
+    {
+        PutU32( (unsigned int)( v & 0xffffffff ) );
+        PutU32( (unsigned int)( ( v >> 32 ) & 0xffffffff ) );
+    }
+
+    void PutStr( const StrPtr& s )
+    {
+        PutU32( s.Length() );
+        buf.Extend( s.Text(), s.Length() );
+    }
+
+    void PutStr( const char* s, int l )
+    {
+        PutU32( l );
+        buf.Extend( s, l );
+    }
+
+    // A pointer, in the width and byte order of the machine: it only
+    // means anything to a reader in the same process
+    void PutPtr( const void* p )
+    {
+        buf.Extend( (const char*)&p, sizeof( p ) );
+    }
+
+    // Reserve a u32 to be filled in later with SetU32()
+    int Mark()
+    {
+        int at = buf.Length();
+        PutU32( 0 );
+        return at;
+    }
+
+    void SetU32( int at, unsigned int v )
+    {
+        char* b = buf.Text() + at;
+        b[0] = (char)( v & 0xff );
+        b[1] = (char)( ( v >> 8 ) & 0xff );
+        b[2] = (char)( ( v >> 16 ) & 0xff );
+        b[3] = (char)( ( v >> 24 ) & 0xff );
+    }
+
+    // Count-prefixed key/value pairs
+    void PutDict( StrDict* d )
+    {
+        StrRef var, val;
+        int at = Mark();
+        int n = 0;
+        for( ; d->GetVar( n, var, val ); n++ ) {
+            PutStr( var );
+            PutStr( val );
+        }
+        SetU32( at, n );
+    }
+
+  private:
+    StrBuf& buf;
+};
@@ -0,0 +1,218 @@
+/*******************************************************************************
+
+Copyright (c) 2024, Perforce Software, Inc.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <p4/clientapi.h>
+#include <p4/spec.h>
+#include "p4gospecmgr.h"
+#include "p4goencode.h"
+#include "p4gofilelog.h"
+
+#define REV_FIELDS 10
+#define INTEG_FIELDS 4
+
+static const char* const revFields[REV_FIELDS] = {
+    "rev", "change", "action", "type", "time",
+    "user", "client", "desc", "digest", "fileSize"
+};
+
+static const char* const integFields[INTEG_FIELDS] = {
+    "how", "file", "srev", "erev"
+};
+
+// Index of a base name in one of the field lists, or -1
+static int
+FieldIndex( const char* const* fields, int n, const char* base, int len )
+{
+    for( int i = 0; i < n; i++ )
+        if( !strncmp( fields[i], base, len ) && !fields[i][len] )
+            return i;
+    return -1;
+}
+
+P4GoFilelog::P4GoFilelog()
+{
+    revs = 0;
+    nrevs = 0;
+    maxRevs = 0;
+    integs = 0;
+    nintegs = 0;
+    maxIntegs = 0;
+    sorted = true;
+}
+
+P4GoFilelog::~P4GoFilelog()
+{
+    delete[] revs;
+    delete[] integs;
+}
+
+void
+P4GoFilelog::Clear()
+{
+    nrevs = 0;
+    nintegs = 0;
+    sorted = true;
+}
+
+StrRef*
+P4GoFilelog::Rev( int n )
+{
+    if( n >= maxRevs ) {
+        int max = maxRevs ? maxRevs * 2 : 64;
+        while( max <= n )
+            max *= 2;
+        StrRef* r = new StrRef[max * REV_FIELDS];
+        for( int i = 0; i < nrevs * REV_FIELDS; i++ )
+            r[i] = revs[i];
+        delete[] revs;
+        revs = r;
+        maxRevs = max;
+    }
+    if( n >= nrevs ) {
+        for( int i = nrevs * REV_FIELDS; i < ( n + 1 ) * REV_FIELDS; i++ )
+            revs[i].Set( StrRef::Null() );
+        nrevs = n + 1;
+    }
+    return revs + n * REV_FIELDS;
+}
+
+P4GoFilelog::Integ*
+P4GoFilelog::Integration( int rev, int n )
+{
+    // Filelog output is in order, so the one we want is nearly always
+    // either the most recent or a new one after it. Only search if not.
+    if( nintegs ) {
+        Integ* last = &integs[nintegs - 1];
+        if( last->rev == rev && last->n == n )
+            return last;
+        if( rev < last->rev || ( rev == last->rev && n < last->n ) ) {
+            for( int i = 0; i < nintegs - 1; i++ )
+                if( integs[i].rev == rev && integs[i].n == n )
+                    return &integs[i];
+            sorted = false;
+        }
+    }
+
+    if( nintegs == maxIntegs ) {
+        int max = maxIntegs ? maxIntegs * 2 : 64;
+        Integ* r = new Integ[max];
+        for( int i = 0; i < nintegs; i++ )
+            r[i] = integs[i];
+        delete[] integs;
+        integs = r;
+        maxIntegs = max;
+    }
+
+    Integ* in = &integs[nintegs++];
+    in->rev = rev;
+    in->n = n;
+    for( int i = 0; i < INTEG_FIELDS; i++ )
+        in->f[i].Set( StrRef::Null() );
+    return in;
+}
+
+int
+P4GoFilelog::Compare( const void* a, const void* b )
+{
+    const Integ* x = (const Integ*)a;
+    const Integ* y = (const Integ*)b;
+    if( x->rev != y->rev )
+        return x->rev < y->rev ? -1 : 1;
+    return x->n < y->n ? -1 : x->n > y->n;
+}
+
+void
+P4GoFilelog::Pack( P4GoEncoder& enc, StrDict* d )
+{
+    Clear();
+
+    StrRef var, val;
+    StrPtr* depotFile = 0;
+
+    for( int i = 0; d->GetVar( i, var, val ); i++ ) {
+        int len = P4GoSpecMgr::BaseLength( var );
+        const char* index = var.Text() + len;
+        if( !*index ) {
+            if( var == "depotFile" )
+                depotFile = d->GetVar( var );
+            continue;
+        }
+
+        char* end;
+        int rev = strtol( index, &end, 10 );
+        if( !*end ) {
+            int f = FieldIndex( revFields, REV_FIELDS, var.Text(), len );
+            if( f >= 0 )
+                Rev( rev )[f] = val;
+        } else if( *end == ',' ) {
+            int n = strtol( end + 1, &end, 10 );
+            int f = FieldIndex( integFields, INTEG_FIELDS, var.Text(), len );
+            if( f < 0 || *end )
+                continue;
+            Integration( rev, n )->f[f] = val;
+        }
+    }
+
+    if( !sorted )
+        qsort( integs, nintegs, sizeof( Integ ), Compare );
+
+    enc.PutByte( depotFile != 0 );
+    if( depotFile )
+        enc.PutStr( *depotFile );
+    else
+        enc.PutStr( "", 0 );
+
+    enc.PutU32( nrevs );
+    int in = 0;
+    for( int r = 0; r < nrevs; r++ ) {
+        StrRef* fields = Rev( r );
+        for( int f = 0; f < REV_FIELDS; f++ )
+            enc.PutStr( fields[f] );
+
+        while( in < nintegs && integs[in].rev < r )
+            in++;
+
+        // Count the complete, consecutive integrations
+        int count = 0;
+        for( int i = in; i < nintegs && integs[i].rev == r; i++ ) {
+            if( integs[i].n != count )
+                break;
+            int f = 0;
+            while( f < INTEG_FIELDS && integs[i].f[f].Length() )
+                f++;
+            if( f < INTEG_FIELDS )
+                break;
+            count++;
+        }
+
+        enc.PutU32( count );
+        for( int i = in; i < in + count; i++ )
+            for( int f = 0; f < INTEG_FIELDS; f++ )
+                enc.PutStr( integs[i].f[f] );
+    }
+}
@@ -0,0 +1,74 @@
+/*******************************************************************************
+
+Copyright (c) 2024, Perforce Software, Inc.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+//
+// P4GoFilelog packs tagged filelog output as depot files, revisions and
+// integrations, so that Go doesn't have to reassemble them from keys such
+// as "rev3" and "how3,1". The record is walked once, splitting each key
+// into its base name and index.
+//
+//     u8 has depotFile, string depotFile, u32 revisions,
+//     revisions x ( 10 x string, u32 integrations,
+//                   integrations x 4 x string )
+//
+// The revision fields are rev, change, action, type, time, user, client,
+// desc, digest and fileSize; the integration fields are how, file, srev
+// and erev. Missing fields are empty. A revision's integrations stop at
+// the first one that is incomplete.
+//
+
+class P4GoFilelog
+{
+  public:
+    P4GoFilelog();
+    ~P4GoFilelog();
+
+    void Pack( P4GoEncoder& enc, StrDict* d );
+
+  private:
+    struct Integ
+    {
+        int rev;
+        int n;
+        StrRef f[4];
+    };
+
+    void Clear();
+    StrRef* Rev( int n );
+    Integ* Integration( int rev, int n );
+    static int Compare( const void* a, const void* b );
+
+  private:
+    StrRef* revs;
+    int nrevs;
+    int maxRevs;
+
+    Integ* integs;
+    int nintegs;
+    int maxIntegs;
+    bool sorted;
+};
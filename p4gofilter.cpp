@@ -0,0 +1,134 @@
+/*******************************************************************************
+
+Copyright (c) 2024, Perforce Software, Inc.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+#include <errno.h>
+#include <p4/clientapi.h>
+#include <p4/vararray.h>
+#include <p4/strarray.h>
+#include "p4gofilter.h"
+
+P4GoFilter::P4GoFilter() {}
+
+P4GoFilter::~P4GoFilter()
+{
+    Clear();
+}
+
+void
+P4GoFilter::Clear()
+{
+    for( int i = 0; i < terms.Count(); i++ )
+        delete (Term*)terms.Get( i );
+    terms.Clear();
+    projection.Clear();
+}
+
+void
+P4GoFilter::Project( const char* key )
+{
+    projection.Put()->Set( key );
+}
+
+void
+P4GoFilter::Where( const char* key, int op, const char* value )
+{
+    Term* t = new Term;
+    t->key.Set( key );
+    t->op = op;
+    t->value.Set( value );
+    t->number = 0;
+    t->numeric = ToNumber( t->value, t->number );
+    terms.Put( t );
+}
+
+bool
+P4GoFilter::ToNumber( const StrPtr& s, P4INT64& n )
+{
+    if( !s.Length() )
+        return false;
+
+    char* end;
+    errno = 0;
+    n = strtoll( s.Text(), &end, 10 );
+    return !errno && end == s.Text() + s.Length();
+}
+
+bool
+P4GoFilter::Test( Term* t, StrPtr* v )
+{
+    if( !v )
+        return false;
+
+    switch( t->op ) {
+    case FILTER_EQ:
+        return *v == t->value;
+    case FILTER_NE:
+        return *v != t->value;
+    case FILTER_PREFIX:
+        return v->Length() >= t->value.Length() &&
+               !memcmp( v->Text(), t->value.Text(), t->value.Length() );
+    }
+
+    P4INT64 n;
+    if( !t->numeric || !ToNumber( *v, n ) )
+        return false;
+
+    switch( t->op ) {
+    case FILTER_LT:
+        return n < t->number;
+    case FILTER_LE:
+        return n <= t->number;
+    case FILTER_GT:
+        return n > t->number;
+    case FILTER_GE:
+        return n >= t->number;
+    }
+    return false;
+}
+
+bool
+P4GoFilter::Accept( StrDict* d )
+{
+    for( int i = 0; i < terms.Count(); i++ ) {
+        Term* t = (Term*)terms.Get( i );
+        if( !Test( t, d->GetVar( t->key ) ) )
+            return false;
+    }
+    return true;
+}
+
+bool
+P4GoFilter::Keep( const StrPtr& key )
+{
+    if( !projection.Count() )
+        return true;
+
+    for( int i = 0; i < projection.Count(); i++ )
+        if( *projection.Get( i ) == key )
+            return true;
+    return false;
+}
@@ -0,0 +1,83 @@
+/*******************************************************************************
+
+Copyright (c) 2024, Perforce Software, Inc.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+//
+// P4GoFilter is applied to tagged output in OutputStat, before a record
+// is copied into the results or handed to Go. Records that fail any of
+// the predicates are dropped, and if there is a projection only the
+// listed fields of the rest are kept. A key that a record lacks fails any
+// predicate on it. The ordering comparisons are numeric, and fail if
+// either side is not a number.
+//
+
+enum P4GoFilterOp
+{
+    FILTER_EQ,
+    FILTER_NE,
+    FILTER_PREFIX,
+    FILTER_LT,
+    FILTER_LE,
+    FILTER_GT,
+    FILTER_GE
+};
+
+class P4GoFilter
+{
+  public:
+    P4GoFilter();
+    ~P4GoFilter();
+
+    void Clear();
+
+    // Keep only this field (may be called repeatedly)
+    void Project( const char* key );
+
+    // Require the record to satisfy 'key op value'
+    void Where( const char* key, int op, const char* value );
+
+    bool Active() { return projection.Count() || terms.Count(); }
+
+    bool Accept( StrDict* d );
+    bool Keep( const StrPtr& key );
+
+  private:
+    struct Term
+    {
+        StrBuf key;
+        int op;
+        StrBuf value;
+        P4INT64 number;
+        bool numeric;
+    };
+
+    static bool ToNumber( const StrPtr& s, P4INT64& n );
+    bool Test( Term* t, StrPtr* v );
+
+  private:
+    StrArray projection;
+    VarArray terms;
+};
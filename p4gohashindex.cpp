@@ -0,0 +1,125 @@
+/*******************************************************************************
+
+Copyright (c) 2024, Perforce Software, Inc.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+#include <p4/clientapi.h>
+#include "p4goarena.h"
+#include "p4gohashindex.h"
+
+P4GoHashIndex::P4GoHashIndex( P4GoArena* a )
+{
+    arena = a;
+    slots = 0;
+    nslots = 0;
+    count = 0;
+}
+
+P4GoHashIndex::~P4GoHashIndex()
+{
+    if( !arena )
+        delete[] slots;
+}
+
+unsigned int
+P4GoHashIndex::Hash( const char* p, int len )
+{
+    unsigned int h = 2166136261u;
+    while( len-- > 0 ) {
+        h ^= (unsigned char)*p++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void
+P4GoHashIndex::Rehash( int size )
+{
+    Slot* old = slots;
+    int nold = nslots;
+
+    // An arena can't give memory back, so the old slots are simply
+    // abandoned to it; doubling keeps the waste below the final size.
+    if( arena )
+        slots = (Slot*)arena->Alloc( size * sizeof( Slot ) );
+    else
+        slots = new Slot[size];
+    nslots = size;
+    for( int i = 0; i < nslots; i++ )
+        slots[i].value = 0;
+
+    for( int i = 0; i < nold; i++ ) {
+        if( !old[i].value )
+            continue;
+        int s = old[i].hash & ( nslots - 1 );
+        while( slots[s].value )
+            s = ( s + 1 ) & ( nslots - 1 );
+        slots[s] = old[i];
+    }
+
+    if( !arena )
+        delete[] old;
+}
+
+void
+P4GoHashIndex::Insert( unsigned int h, int value )
+{
+    if( ( count + 1 ) * 2 > nslots )
+        Rehash( nslots ? nslots * 2 : 64 );
+
+    int s = h & ( nslots - 1 );
+    while( slots[s].value )
+        s = ( s + 1 ) & ( nslots - 1 );
+
+    slots[s].hash = h;
+    slots[s].value = value + 1;
+    count++;
+}
+
+int
+P4GoHashIndex::Probe( unsigned int h, int& pos )
+{
+    if( !nslots )
+        return -1;
+
+    pos = pos < 0 ? h & ( nslots - 1 ) : ( pos + 1 ) & ( nslots - 1 );
+
+    // There is always an empty slot to stop at
+    for( ; slots[pos].value; pos = ( pos + 1 ) & ( nslots - 1 ) )
+        if( slots[pos].hash == h )
+            return slots[pos].value - 1;
+    return -1;
+}
+
+void
+P4GoHashIndex::Clear()
+{
+    if( !count )
+        return;
+
+    for( int i = 0; i < nslots; i++ )
+        slots[i].value = 0;
+    count = 0;
+}
@@ -0,0 +1,77 @@
+/*******************************************************************************
+
+Copyright (c) 2024, Perforce Software, Inc.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+//
+// P4GoHashIndex maps hashes to small non-negative integers, usually
+// positions in an array belonging to the caller, who is left to compare
+// the actual keys. It is open addressed with linear probing and kept no
+// more than half full. Slots come from the heap or, for an index that
+// lives in a P4GoArena and never has its destructor run, from the arena.
+//
+
+class P4GoArena;
+
+class P4GoHashIndex
+{
+  public:
+    P4GoHashIndex( P4GoArena* a = 0 );
+    ~P4GoHashIndex();
+
+    // FNV-1a
+    static unsigned int Hash( const char* p, int len );
+    static unsigned int Hash( const StrPtr& s )
+    {
+        return Hash( s.Text(), s.Length() );
+    }
+
+    // Add a value under hash h. Nothing checks for duplicates.
+    void Insert( unsigned int h, int value );
+
+    // Step through the values stored under hash h: start with pos set to
+    // -1 and call until it returns -1.
+    int Probe( unsigned int h, int& pos );
+
+    // Forget every value, keeping the slots for reuse
+    void Clear();
+
+    int Count() { return count; }
+
+  private:
+    struct Slot
+    {
+        unsigned int hash;
+        int value; // value + 1, or 0 if the slot is empty
+    };
+
+    void Rehash( int size );
+
+  private:
+    P4GoArena* arena;
+    Slot* slots;
+    int nslots;
+    int count;
+};
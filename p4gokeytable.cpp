@@ -0,0 +1,81 @@
+/*******************************************************************************
+
+Copyright (c) 2024, Perforce Software, Inc.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+#include <p4/clientapi.h>
+#include "p4goarena.h"
+#include "p4gohashindex.h"
+#include "p4gokeytable.h"
+
+P4GoKeyTable::P4GoKeyTable()
+{
+    keys = 0;
+    count = 0;
+    max = 0;
+}
+
+P4GoKeyTable::~P4GoKeyTable()
+{
+    delete[] keys;
+}
+
+void
+P4GoKeyTable::Reset()
+{
+    if( !count )
+        return;
+
+    count = 0;
+    index.Clear();
+    store.Reset();
+}
+
+int
+P4GoKeyTable::Intern( const StrPtr& key )
+{
+    unsigned int h = P4GoHashIndex::Hash( key );
+    int pos = -1;
+
+    for( int id; ( id = index.Probe( h, pos ) ) >= 0; )
+        if( keys[id].Length() == key.Length() &&
+            !memcmp( keys[id].Text(), key.Text(), key.Length() ) )
+            return id;
+
+    if( count == max ) {
+        int n = max ? max * 2 : 32;
+        StrRef* nkeys = new StrRef[n];
+        for( int i = 0; i < count; i++ )
+            nkeys[i] = keys[i];
+        delete[] keys;
+        keys = nkeys;
+        max = n;
+    }
+
+    int id = count++;
+    keys[id].Set( store.Copy( key.Text(), key.Length() ), key.Length() );
+    index.Insert( h, id );
+    return id;
+}
@@ -25,13 +25,33 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 *******************************************************************************/
 
-#ifndef P4GODEBUG_H
-#define P4GODEBUG_H
-
-#define P4GODB_COMMANDS ( debug > 0 )
-#define P4GODB_CALLS ( debug > 1 )
-#define P4GODB_DATA ( debug > 2 )
-#define P4GODB_RPC ( debug > 8 )
-#define P4GODB_SSL ( debug > 10 )
-
-#endif
+//
+// P4GoKeyTable interns the keys of tagged output. Every record of a
+// command tends to repeat the same handful of keys, so each is stored once
+// and given a small integer ID; dictionaries hold the ID and a reference
+// to the stored key, and the packed buffers sent to Go carry only the ID.
+// IDs are handed out in order from zero and are good until Reset().
+//
+
+class P4GoKeyTable
+{
+  public:
+    P4GoKeyTable();
+    ~P4GoKeyTable();
+
+    // The ID for a key, adding the key if it is new
+    int Intern( const StrPtr& key );
+
+    const StrRef& Key( int id ) { return keys[id]; }
+
+    int Count() { return count; }
+
+    void Reset();
+
+  private:
+    P4GoArena store;
+    P4GoHashIndex index;
+    StrRef* keys;
+    int count;
+    int max;
+};
@@ -25,6 +25,7 @@
 
  *******************************************************************************/
 
+#include <atomic>
 #include <p4/clientapi.h>
 #include <p4/i18napi.h>
 #include <p4/strtable.h>
@@ -32,13 +33,15 @@
 #include <p4/spec.h>
 #include "p4gomergedata.h"
 #include "p4gospecmgr.h"
+#include "p4goarena.h"
+#include "p4gohashindex.h"
+#include "p4gokeytable.h"
 #include "p4goresult.h"
-#include "p4godebug.h"
+#include "p4gometrics.h"
 #include "p4goclientuser.h"
 
 P4GoMergeData::P4GoMergeData( ClientUser* ui, ClientMerge* m, void* info )
 {
-    this->debug = 0;
     this->actionmerger = 0;
     this->ui = ui;
     this->merger = m;
@@ -57,7 +60,6 @@ P4GoMergeData::P4GoMergeData( ClientUser* ui, ClientMerge* m, void* info )
 
 P4GoMergeData::P4GoMergeData( ClientUser* ui, ClientResolveA* m, void* info )
 {
-    this->debug = 0;
     this->merger = 0;
     this->ui = ui;
     this->hint = m->AutoResolve( CMF_FORCE );
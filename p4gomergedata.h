@@ -31,8 +31,6 @@ class P4GoMergeData
     P4GoMergeData( ClientUser* ui, ClientMerge* m, void* info );
     P4GoMergeData( ClientUser* ui, ClientResolveA* m, void* info );
 
-    void SetDebug( int d ) { debug = d; }
-
     //	Content resolve
     char* GetYourName();
     char* GetTheirName();
@@ -62,7 +60,6 @@ class P4GoMergeData
     int GetMergeHint();
 
   private:
-    int debug;
     ClientUser* ui;
     MergeStatus hint;
     ClientMerge* merger;
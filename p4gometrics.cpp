@@ -0,0 +1,116 @@
+/*******************************************************************************
+
+Copyright (c) 2024, Perforce Software, Inc.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <p4/clientapi.h>
+#include "p4gospecmgr.h"
+#include "p4goarena.h"
+#include "p4gohashindex.h"
+#include "p4gokeytable.h"
+#include "p4goresult.h"
+#include "p4gometrics.h"
+
+P4GoMeter::P4GoMeter()
+{
+    memset( &last, 0, sizeof( last ) );
+    memset( &total, 0, sizeof( total ) );
+    parent = 0;
+    started = 0;
+    running = 0;
+    seen = 0;
+}
+
+long long
+P4GoMeter::Now()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch() )
+      .count();
+}
+
+void
+P4GoMeter::Start()
+{
+    memset( &last, 0, sizeof( last ) );
+    started = Now();
+    running = 1;
+    seen = 0;
+}
+
+void
+P4GoMeter::End()
+{
+    last.total = Now() - started;
+    running = 0;
+
+    total.commands += last.commands;
+    total.firstRecord += last.firstRecord;
+    total.total += last.total;
+    total.handlerTime += last.handlerTime;
+    total.crossings += last.crossings;
+    for( int i = STRING; i <= SPEC; i++ )
+        total.records[i] += last.records[i];
+    total.textBytes += last.textBytes;
+    total.binaryBytes += last.binaryBytes;
+}
+
+void
+P4GoMeter::ResetTotal()
+{
+    memset( &total, 0, sizeof( total ) );
+}
+
+void
+P4GoMeter::Received( int type, int bytes )
+{
+    if( !seen ) {
+        last.firstRecord = Now() - started;
+        seen = 1;
+    }
+
+    if( type >= STRING && type <= SPEC )
+        last.records[type]++;
+
+    if( type == STRING )
+        last.textBytes += bytes;
+    else if( type == BINARY )
+        last.binaryBytes += bytes;
+
+    if( parent )
+        parent->Received( type, bytes );
+}
+
+void
+P4GoMeter::Crossed( long long since )
+{
+    last.crossings++;
+    last.handlerTime += Now() - since;
+
+    if( parent )
+        parent->Crossed( since );
+}
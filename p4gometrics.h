@@ -0,0 +1,103 @@
+/*******************************************************************************
+
+Copyright (c) 2024, Perforce Software, Inc.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+//
+// What running commands costs, for finding out where the time goes: in
+// the server and the network, before the first of the output arrives, or
+// in the binding and the callers' handlers afterwards. Times are in
+// microseconds. This is plain C, so that Go can read it.
+//
+
+typedef struct P4GoMetrics
+{
+    long long commands;    // commands sent
+    long long firstRecord; // from starting the run to the first output
+    long long total;       // from starting the run to the end of it
+    long long handlerTime; // spent in callbacks into Go
+    long long crossings;   // callbacks into Go
+    long long records[6];  // output received, by P4GoResultType
+    long long textBytes;
+    long long binaryBytes;
+    long long reconnects;  // connections made again after being dropped
+} P4GoMetrics;
+
+#ifdef __cplusplus
+
+//
+// P4GoMeter keeps the metrics of a connection: those of the last run, and
+// those of every run since it was reset. Each command of a batch has a
+// meter of its own too, whose parent is the connection's: what it is
+// given is passed on, so the connection's meter still sees the lot.
+//
+
+class P4GoMeter
+{
+  public:
+    P4GoMeter();
+
+    void Start();
+    void End();
+    void ResetTotal();
+
+    void SetParent( P4GoMeter* p ) { parent = p; }
+    P4GoMeter* Parent() { return parent; }
+
+    // Started and not yet ended
+    int Running() { return running; }
+
+    void Sent()
+    {
+        last.commands++;
+        if( parent )
+            parent->Sent();
+    }
+
+    // Reconnects count towards the total whether or not a run is going
+    void Reconnected()
+    {
+        last.reconnects++;
+        total.reconnects++;
+    }
+    void Received( int type, int bytes );
+
+    // For timing a callback: pass the time it started, from Now()
+    static long long Now();
+    void Crossed( long long since );
+
+    const P4GoMetrics& Last() { return last; }
+    const P4GoMetrics& Total() { return total; }
+
+  private:
+    P4GoMetrics last;
+    P4GoMetrics total;
+    P4GoMeter* parent;
+    long long started;
+    int running;
+    int seen; // any output yet
+};
+
+#endif
@@ -25,11 +25,17 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 *******************************************************************************/
 
+#include <new>
 #include <p4/clientapi.h>
 #include <p4/vararray.h>
 #include <p4/strarray.h>
 #include <p4/spec.h>
 #include "p4gospecmgr.h"
+#include "p4goencode.h"
+#include "p4gofilelog.h"
+#include "p4goarena.h"
+#include "p4gohashindex.h"
+#include "p4gokeytable.h"
 #include "p4goresult.h"
 
 P4GoResults::P4GoResults()
@@ -46,11 +52,9 @@ P4GoResults::~P4GoResults()
 void
 P4GoResults::Reset()
 {
-    // Remove from the end to prevent moving
-    for( int i = Count() - 1; i >= 0; i-- ) {
-        Destroy( Get( i ) );
-        Remove( i );
-    }
+    Discard();
+    keys.Reset();
+    keysSent = 0;
 
     infoCount = 0;
     warnCount = 0;
@@ -61,6 +65,31 @@ P4GoResults::Reset()
     stringCount = 0;
 }
 
+void
+P4GoResults::Discard()
+{
+    // The results themselves are in the arena, so there is nothing to
+    // free one by one beyond what they own on the heap.
+    for( int i = 0; i < Count(); i++ )
+        Destroy( Get( i ) );
+    Clear();
+    arena.Reset();
+
+    packed.Clear();
+}
+
+void
+P4GoResults::Truncate( int start, const P4GoArenaMark& mark )
+{
+    for( int i = Count() - 1; i >= start; i-- ) {
+        Destroy( Get( i ) );
+        Remove( i );
+    }
+    arena.Release( mark );
+
+    packed.Clear();
+}
+
 int
 P4GoResults::Compare( const void* r1, const void* r2 ) const
 {
@@ -70,12 +99,29 @@ P4GoResults::Compare( const void* r1, const void* r2 ) const
 void
 P4GoResults::Destroy( void* r ) const
 {
-    // Delete the object if it belongs to us
     P4GoResult* res = (P4GoResult*)r;
-    if( !res->taken )
-        delete res;
-    else
-        res->taken = 2;
+    if( res->type == ERROR )
+        delete res->err;
+    else if( res->type == SPEC )
+        delete res->spec;
+}
+
+P4GoResult*
+P4GoResults::NewResult( P4GoResultType type )
+{
+    P4GoResult* r = new( arena.Alloc( sizeof( P4GoResult ) ) ) P4GoResult;
+    r->type = type;
+    r->dict = 0;
+    r->err = 0;
+    r->spec = 0;
+    Put( r );
+    return r;
+}
+
+P4GoArenaDict*
+P4GoResults::NewDict()
+{
+    return new( arena.Alloc( sizeof( P4GoArenaDict ) ) ) P4GoArenaDict( &arena, &keys );
 }
 
 //
@@ -88,11 +134,9 @@ P4GoResults::AddOutput( Error* e )
     if( e->GetSeverity() == E_EMPTY )
         return;
 
-    P4GoResult* r = new P4GoResult;
-    r->type = ERROR;
+    P4GoResult* r = NewResult( ERROR );
     r->err = new Error;
     *r->err = *e;
-    Put( r );
 
     if( e->GetSeverity() == E_INFO )
         infoCount++;
@@ -105,58 +149,47 @@ P4GoResults::AddOutput( Error* e )
 void
 P4GoResults::AddOutput( StrPtr o, bool binary )
 {
-    P4GoResult* r = new P4GoResult;
-    r->type = binary ? BINARY : STRING;
-    r->taken = 0;
-    r->str = new StrBuf;
-    *r->str = o;
-    Put( r );
+    P4GoResult* r = NewResult( binary ? BINARY : STRING );
+    r->str.Set( arena.Copy( o.Text(), o.Length() ), o.Length() );
     stringCount++;
 }
 
 void
-P4GoResults::AddOutput( StrDict* d )
+P4GoResults::AddOutput( P4GoArenaDict* d )
 {
-    P4GoResult* r = new P4GoResult;
-    r->type = DICT;
-    r->taken = 0;
+    P4GoResult* r = NewResult( DICT );
     r->dict = d;
-    Put( r );
     dictCount++;
 }
 
 void
 P4GoResults::AddOutput( P4GoSpecData* s )
 {
-    P4GoResult* r = new P4GoResult;
-    r->type = SPEC;
-    r->taken = 0;
+    P4GoResult* r = NewResult( SPEC );
     r->spec = s;
-    Put( r );
     specCount++;
+
+    // Intern the keys now, so that they are all known before Pack()
+    // starts writing
+    StrRef var, val;
+    StrDict* d = s->Dict();
+    for( int i = 0; d->GetVar( i, var, val ); i++ )
+        keys.Intern( var );
+    for( int l = 0; l < s->ListCount(); l++ )
+        keys.Intern( s->ListTag( l ) );
 }
 
 void
 P4GoResults::AddTrack( const char* t )
 {
-    P4GoResult* r = new P4GoResult;
-    r->type = TRACK;
-    r->taken = 0;
-    r->str = new StrBuf;
-    *r->str = t;
-    Put( r );
-    trackCount++;
+    AddTrack( StrRef( t ) );
 }
 
 void
 P4GoResults::AddTrack( StrPtr t )
 {
-    P4GoResult* r = new P4GoResult;
-    r->type = TRACK;
-    r->taken = 0;
-    r->str = new StrBuf;
-    *r->str = t;
-    Put( r );
+    P4GoResult* r = NewResult( TRACK );
+    r->str.Set( arena.Copy( t.Text(), t.Length() ), t.Length() );
     trackCount++;
 }
 
@@ -173,6 +206,318 @@ P4GoResults::DeleteTrack()
     }
 }
 
+//
+// Bulk transfer. Each result is written as a one byte type followed by
+// its payload:
+//
+//     STRING, TRACK            string
+//     BINARY                   pointer, u32 length
+//     DICT                     u32 count, count x ( u32 key ID, value )
+//     SPEC                     as DICT, then u32 lists,
+//                              lists x ( u32 key ID, u32 count,
+//                                        count x value )
+//     ERROR                    u32 severity, u32 count,
+//                              count x ( u32 severity, u32 code, fmt ),
+//                              u32 count, count x ( key, value )
+//
+// A spec is only sent as a SPEC when the reader asks for lists; otherwise
+// it goes as a DICT, with its lists numbered out as View0, View1 and so
+// on. The numbered keys are interned like any others, so a reader that
+// builds a map per spec makes each key string once per command.
+//
+// Strings are a u32 length followed by the bytes. Binary data is not
+// copied into the buffer; the reader is given the address of the data in
+// the result, which stays put until the next command is run.
+//
+// The buffer starts with the keys that have been interned since the last
+// one (u32 first ID, u32 count, count x key), followed by the number of
+// results it contains. A first ID of zero means a new command: the reader
+// should drop any keys it already has.
+//
+
+const StrPtr&
+P4GoResults::Pack( int start, bool allKeys, bool lists )
+{
+    P4GoEncoder enc( packed );
+
+    if( !lists )
+        InternFlat( start );
+
+    packed.Clear();
+    PackKeys( enc, allKeys );
+
+    enc.PutU32( start < Count() ? Count() - start : 0 );
+    for( int i = start; i < Count(); i++ )
+        PackResult( enc, i, lists );
+
+    return packed;
+}
+
+//
+// Intern the numbered keys of the specs' lists from index 'start' on, so
+// that they are known before the keys are written.
+//
+
+void
+P4GoResults::InternFlat( int start )
+{
+    StrBuf key;
+    for( int i = start; i < Count(); i++ ) {
+        P4GoResult* r = (P4GoResult*)Get( i );
+        if( r->type != SPEC )
+            continue;
+
+        P4GoSpecData* spec = r->spec;
+        for( int l = 0; l < spec->ListCount(); l++ ) {
+            for( int v = 0; v < spec->ListLength( l ); v++ ) {
+                key.Clear();
+                key << spec->ListTag( l ) << v;
+                keys.Intern( key );
+            }
+        }
+    }
+}
+
+//
+// Filelog transfer: the number of results, then each as its type byte
+// followed, for a dictionary, by the depot file that P4GoFilelog makes of
+// it. Nothing else is expected from filelog, so nothing else is sent.
+//
+
+const StrPtr&
+P4GoResults::PackFilelog()
+{
+    P4GoEncoder enc( packed );
+    P4GoFilelog filelog;
+
+    packed.Clear();
+    enc.PutU32( Count() );
+    for( int i = 0; i < Count(); i++ ) {
+        P4GoResult* r = (P4GoResult*)Get( i );
+        enc.PutByte( r->type );
+        if( r->type == DICT )
+            filelog.Pack( enc, r->dict );
+    }
+
+    return packed;
+}
+
+void
+P4GoResults::PackKeys( P4GoEncoder& enc, bool allKeys )
+{
+    int first = allKeys ? 0 : keysSent;
+    enc.PutU32( first );
+    enc.PutU32( keys.Count() - first );
+    for( int i = first; i < keys.Count(); i++ )
+        enc.PutStr( keys.Key( i ) );
+    keysSent = keys.Count();
+}
+
+//
+// Columnar transfer, for scanning large tagged result sets without a map
+// per row. Every dictionary result becomes a row, and every key a column
+// holding the row values back to back:
+//
+//     keys                     as for Pack(), always complete
+//     u32 rows, u32 columns
+//     columns x ( u32 key ID, string data, ( rows + 1 ) x u32 offsets,
+//                 ( rows + 7 ) / 8 bytes of presence bitmap )
+//     u32 count, count x result
+//
+// Row r's value is data[ offsets[r] .. offsets[r+1] ), and is only
+// meaningful if bit r of the bitmap is set (bit 0 is the low bit of the
+// first byte). The results that are not dictionaries follow in the
+// ordinary format.
+//
+
+const StrPtr&
+P4GoResults::PackColumns()
+{
+    P4GoEncoder enc( packed );
+
+    InternFlat( 0 );
+
+    packed.Clear();
+    PackKeys( enc, true );
+
+    int rows = 0;
+    for( int i = 0; i < Count(); i++ )
+        if( ( (P4GoResult*)Get( i ) )->type == DICT )
+            rows++;
+
+    // Keys are interned densely, so they index the columns directly
+    int ncols = keys.Count();
+    StrBuf* data = new StrBuf[ncols];
+    StrBuf* offsets = new StrBuf[ncols];
+    int* present = new int[ncols];
+    int maplen = ( rows + 7 ) / 8;
+    StrBuf bitmaps;
+    bitmaps.Alloc( ncols * maplen );
+    memset( bitmaps.Text(), 0, ncols * maplen );
+
+    for( int c = 0; c < ncols; c++ )
+        present[c] = 0;
+
+    int row = 0;
+    for( int i = 0; i < Count(); i++ ) {
+        P4GoResult* r = (P4GoResult*)Get( i );
+        if( r->type != DICT )
+            continue;
+
+        for( int c = 0; c < ncols; c++ )
+            P4GoEncoder( offsets[c] ).PutU32( data[c].Length() );
+
+        StrRef var, val;
+        for( int k = 0; r->dict->GetVar( k, var, val ); k++ ) {
+            int c = r->dict->KeyId( k );
+            data[c].Append( &val );
+            bitmaps.Text()[c * maplen + row / 8] |= 1 << ( row % 8 );
+            present[c]++;
+        }
+        row++;
+    }
+
+    int used = 0;
+    for( int c = 0; c < ncols; c++ )
+        if( present[c] )
+            used++;
+
+    enc.PutU32( rows );
+    enc.PutU32( used );
+    for( int c = 0; c < ncols; c++ ) {
+        if( !present[c] )
+            continue;
+        P4GoEncoder( offsets[c] ).PutU32( data[c].Length() );
+        enc.PutU32( c );
+        enc.PutStr( data[c] );
+        packed.Append( &offsets[c] );
+        packed.Extend( bitmaps.Text() + c * maplen, maplen );
+    }
+
+    delete[] data;
+    delete[] offsets;
+    delete[] present;
+
+    enc.PutU32( Count() - rows );
+    for( int i = 0; i < Count(); i++ )
+        if( ( (P4GoResult*)Get( i ) )->type != DICT )
+            PackResult( enc, i );
+
+    return packed;
+}
+
+void
+P4GoResults::PackResult( P4GoEncoder& enc, int index, bool lists )
+{
+    P4GoResult* r = (P4GoResult*)Get( index );
+    if( r->type == SPEC && !lists ) {
+        enc.PutByte( DICT );
+        PackFlat( enc, r->spec );
+        return;
+    }
+    enc.PutByte( r->type );
+
+    switch( r->type ) {
+    case STRING:
+    case TRACK:
+        enc.PutStr( r->str );
+        break;
+
+    case BINARY:
+        enc.PutPtr( r->str.Text() );
+        enc.PutU32( r->str.Length() );
+        break;
+
+    case DICT:
+        PackDict( enc, r->dict );
+        break;
+
+    case SPEC: {
+        P4GoSpecData* spec = r->spec;
+        PackDict( enc, spec->Dict() );
+        enc.PutU32( spec->ListCount() );
+        for( int l = 0; l < spec->ListCount(); l++ ) {
+            enc.PutU32( keys.Intern( spec->ListTag( l ) ) );
+            enc.PutU32( spec->ListLength( l ) );
+            for( int i = 0; i < spec->ListLength( l ); i++ )
+                enc.PutStr( spec->ListValue( l, i ) );
+        }
+        break;
+    }
+
+    case ERROR: {
+        int n = r->err->GetErrorCount();
+        enc.PutU32( r->err->GetSeverity() );
+        enc.PutU32( n );
+        for( int i = 0; i < n; i++ ) {
+            StrBuf msg;
+            r->err->Fmt( i + 1, msg, 0 );
+            enc.PutU32( r->err->GetId( i )->Severity() );
+            enc.PutU32( r->err->GetId( i )->code );
+            enc.PutStr( msg );
+        }
+        StrDict* d = r->err->GetDict();
+        if( d )
+            enc.PutDict( d );
+        else
+            enc.PutU32( 0 );
+        break;
+    }
+    }
+}
+
+void
+P4GoResults::PackDict( P4GoEncoder& enc, StrDict* d )
+{
+    StrRef var, val;
+    int at = enc.Mark();
+    int n = 0;
+    for( ; d->GetVar( n, var, val ); n++ ) {
+        enc.PutU32( keys.Intern( var ) );
+        enc.PutStr( val );
+    }
+    enc.SetU32( at, n );
+}
+
+//
+// A spec as one dictionary: its fields, then its lists numbered out. The
+// keys were interned by InternFlat().
+//
+
+void
+P4GoResults::PackFlat( P4GoEncoder& enc, P4GoSpecData* spec )
+{
+    StrRef var, val;
+    StrBuf key;
+    int at = enc.Mark();
+    int n = 0;
+    for( ; spec->Dict()->GetVar( n, var, val ); n++ ) {
+        enc.PutU32( keys.Intern( var ) );
+        enc.PutStr( val );
+    }
+    for( int l = 0; l < spec->ListCount(); l++ ) {
+        for( int v = 0; v < spec->ListLength( l ); v++, n++ ) {
+            key.Clear();
+            key << spec->ListTag( l ) << v;
+            enc.PutU32( keys.Intern( key ) );
+            enc.PutStr( spec->ListValue( l, v ) );
+        }
+    }
+    enc.SetU32( at, n );
+}
+
+void
+P4GoResults::PackDict( P4GoEncoder& enc, P4GoArenaDict* d )
+{
+    // Our own dictionaries were interned as they were built
+    StrRef var, val;
+    enc.PutU32( d->Count() );
+    for( int i = 0; d->GetVar( i, var, val ); i++ ) {
+        enc.PutU32( d->KeyId( i ) );
+        enc.PutStr( val );
+    }
+}
+
 int
 P4GoResults::ErrorCount()
 {
@@ -36,12 +36,18 @@ enum P4GoResultType
     SPEC
 };
 
+class P4GoEncoder;
+
+//
+// Results, their text and their dictionaries are all allocated from the
+// arena owned by P4GoResults. Only errors and spec data are on the heap.
+//
+
 struct P4GoResult
 {
     P4GoResultType type;
-    int taken;
-    StrBuf* str;
-    StrDict* dict;
+    StrRef str;
+    P4GoArenaDict* dict;
     Error* err;
     P4GoSpecData* spec;
 };
@@ -58,12 +64,17 @@ class P4GoResults : public VVarArray
     // Setting
     void AddOutput( Error* e );
     void AddOutput( StrPtr o , bool binary=false );
-    void AddOutput( StrDict* d );
+    void AddOutput( P4GoArenaDict* d ); // d must come from NewDict()
     void AddOutput( P4GoSpecData* d );
     void AddTrack( const char* t );
     void AddTrack( StrPtr t );
     void DeleteTrack();
 
+    // An empty dictionary allocated from the arena, for AddOutput()
+    P4GoArenaDict* NewDict();
+
+    P4GoArena* Arena() { return &arena; }
+
     // Get errors/warnings as a formatted string
     void FmtErrors( StrBuf& buf );
     void FmtWarnings( StrBuf& buf );
@@ -71,6 +82,20 @@ class P4GoResults : public VVarArray
     // Set API level for backwards compatibility
     void SetApiLevel( int l ) { apiLevel = l; }
 
+    // Serialize the results from index 'start' onwards into a single
+    // buffer so that Go can collect them in one cgo call. The buffer
+    // belongs to us and is valid until the next Pack() or Reset().
+    // Keys are sent only once per command unless allKeys is set, for a
+    // reader that has not seen the earlier buffers. Specs are sent as
+    // dictionaries, with their lists numbered out, unless lists is set.
+    const StrPtr& Pack( int start = 0, bool allKeys = false, bool lists = false );
+
+    // As Pack(), but with the dictionaries laid out as columns
+    const StrPtr& PackColumns();
+
+    // Filelog output, decoded into revisions and integrations
+    const StrPtr& PackFilelog();
+
     // Testing
     int ErrorCount();
     int WarningCount();
@@ -78,10 +103,24 @@ class P4GoResults : public VVarArray
     // Clear previous results
     void Reset();
 
+    // Drop the stored results, but keep the message counts
+    void Discard();
+
+    // Drop the results from index 'start' onwards, and release what was
+    // allocated for them since the arena was marked. Counts are kept.
+    void Truncate( int start, const P4GoArenaMark& mark );
+
   private:
     void Fmt( const char* label, void* ary, StrBuf& buf );
     char* FmtMessage( Error* e );
     char* WrapMessage( Error* e );
+    void PackKeys( P4GoEncoder& enc, bool allKeys );
+    void PackResult( P4GoEncoder& enc, int index, bool lists = false );
+    void PackDict( P4GoEncoder& enc, StrDict* d );
+    void PackDict( P4GoEncoder& enc, P4GoArenaDict* d );
+    void PackFlat( P4GoEncoder& enc, P4GoSpecData* spec );
+    void InternFlat( int start );
+    P4GoResult* NewResult( P4GoResultType type );
 
     int infoCount;
     int warnCount;
@@ -92,4 +131,9 @@ class P4GoResults : public VVarArray
     int stringCount;
 
     int apiLevel;
+
+    StrBuf packed;
+    P4GoArena arena;
+    P4GoKeyTable keys;
+    int keysSent;
 };
@@ -30,17 +30,16 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <p4/strops.h>
 #include <p4/spec.h>
 #include <p4/strtable.h>
-#include "p4godebug.h"
+#include <p4/vararray.h>
+#include <p4/strarray.h>
+#include "p4gohashindex.h"
+#include "p4gospecregistry.h"
 #include "p4gospecmgr.h"
 
 //
 // Generated specdata struct. See //builds/p24.2/p4-bin/bin.noarch/specstr.raw
 //
-struct specdata
-{
-    const char* type;
-    const char* spec;
-} speclist[] = {
+struct specdata speclist[] = {
  
     {
     "branch",
@@ -325,60 +324,221 @@ struct specdata
 //
 
 
+//
+// A parsed specdef, and the field map derived from it, kept per type so
+// that we don't reparse the specdef for every spec we handle. Entries
+// are dropped when the specdef for their type changes.
+//
+
+class P4GoSpecCache
+{
+  public:
+    P4GoSpecCache( const char* t ) : type( t ), spec( 0 ), fields( 0 ) {}
+    ~P4GoSpecCache()
+    {
+        delete spec;
+        delete fields;
+    }
+
+    StrBuf type;
+    Spec* spec;
+    StrDict* fields;
+};
+
+struct P4GoSpecList
+{
+    StrBuf tag;
+    StrArray values;
+};
+
 P4GoSpecData::P4GoSpecData( StrDict* dict )
   : SpecDataTable( dict )
 {
     extras = new StrBufDict;
+    lists = 0;
+    flat = 0;
 }
 
 P4GoSpecData::~P4GoSpecData()
 {
+    if( lists ) {
+        for( int i = 0; i < lists->Count(); i++ )
+            delete (P4GoSpecList*)lists->Get( i );
+        delete lists;
+    }
+    delete flat;
     delete extras;
 }
 
+int
+P4GoSpecData::AddList( const StrPtr& tag )
+{
+    if( !lists )
+        lists = new VarArray;
+
+    P4GoSpecList* l = new P4GoSpecList;
+    l->tag = tag;
+    lists->Put( l );
+    return lists->Count() - 1;
+}
+
+void
+P4GoSpecData::AddListValue( int l, const StrPtr& val )
+{
+    *( (P4GoSpecList*)lists->Get( l ) )->values.Put() = val;
+}
+
+int
+P4GoSpecData::ListCount()
+{
+    return lists ? lists->Count() : 0;
+}
+
+const StrPtr&
+P4GoSpecData::ListTag( int l )
+{
+    return ( (P4GoSpecList*)lists->Get( l ) )->tag;
+}
+
+int
+P4GoSpecData::ListLength( int l )
+{
+    return ( (P4GoSpecList*)lists->Get( l ) )->values.Count();
+}
+
+const StrPtr&
+P4GoSpecData::ListValue( int l, int i )
+{
+    return *( (P4GoSpecList*)lists->Get( l ) )->values.Get( i );
+}
+
+StrDict*
+P4GoSpecData::Flat()
+{
+    if( !ListCount() )
+        return Dict();
+
+    if( flat )
+        return flat;
+
+    flat = new StrBufDict;
+
+    StrRef var, val;
+    for( int i = 0; Dict()->GetVar( i, var, val ); i++ )
+        flat->SetVar( var, val );
+
+    for( int l = 0; l < ListCount(); l++ ) {
+        for( int i = 0; i < ListLength( l ); i++ ) {
+            StrBuf key;
+            key << ListTag( l ) << i;
+            flat->SetVar( key, ListValue( l, i ) );
+        }
+    }
+    return flat;
+}
+
 P4GoSpecMgr::P4GoSpecMgr()
 {
-    debug = 0;
     specs = 0;
+    cache = new VarArray;
     convertArray = 1;
     Reset();
 }
 
 P4GoSpecMgr::~P4GoSpecMgr()
 {
-    delete specs;
+    ClearCache();
+    delete cache;
+    P4GoSpecRegistry::Release( specs );
 }
 
 void
 P4GoSpecMgr::AddSpecDef( const char* type, StrPtr& specDef )
 {
-    if( specs->GetVar( type ) )
-        specs->RemoveVar( type );
-    specs->SetVar( type, specDef );
+    AddSpecDef( type, specDef.Text() );
 }
 
 void
 P4GoSpecMgr::AddSpecDef( const char* type, const char* specDef )
 {
-    if( specs->GetVar( type ) )
-        specs->RemoveVar( type );
-    specs->SetVar( type, specDef );
+    // Servers send the specdef with every spec, so the common case is
+    // that we already have exactly this one. Otherwise move to the shared
+    // set that has it, rather than changing the one we're using.
+    P4GoSpecSet* next = P4GoSpecRegistry::Update( specs, server,
+                                                  type, specDef );
+    if( next == specs )
+        return;
+
+    P4GoSpecRegistry::Release( specs );
+    specs = next;
+    Invalidate( type );
 }
 
 void
 P4GoSpecMgr::Reset()
 {
-    delete specs;
-    specs = new StrBufDict;
-
-    for( struct specdata* sp = &speclist[0]; sp->type; sp++ )
-        AddSpecDef( sp->type, sp->spec );
+    P4GoSpecRegistry::Release( specs );
+    specs = P4GoSpecRegistry::Builtin();
+    ClearCache();
 }
 
 int
 P4GoSpecMgr::HaveSpecDef( const char* type )
 {
-    return specs->GetVar( type ) != 0;
+    return specs->Get( type ) != 0;
+}
+
+Spec*
+P4GoSpecMgr::GetSpec( const char* type, Error* e )
+{
+    P4GoSpecCache* c = Entry( type, e );
+    return c ? c->spec : 0;
+}
+
+P4GoSpecCache*
+P4GoSpecMgr::Entry( const char* type, Error* e )
+{
+    for( int i = 0; i < cache->Count(); i++ ) {
+        P4GoSpecCache* c = (P4GoSpecCache*)cache->Get( i );
+        if( c->type == type )
+            return c;
+    }
+
+    StrPtr* specDef = specs->Get( type );
+    if( !specDef )
+        return 0;
+
+    Spec* s = new Spec( specDef->Text(), "", e );
+    if( e->Test() ) {
+        delete s;
+        return 0;
+    }
+
+    P4GoSpecCache* c = new P4GoSpecCache( type );
+    c->spec = s;
+    cache->Put( c );
+    return c;
+}
+
+void
+P4GoSpecMgr::Invalidate( const char* type )
+{
+    for( int i = 0; i < cache->Count(); i++ ) {
+        P4GoSpecCache* c = (P4GoSpecCache*)cache->Get( i );
+        if( c->type == type ) {
+            cache->Remove( i );
+            delete c;
+            return;
+        }
+    }
+}
+
+void
+P4GoSpecMgr::ClearCache()
+{
+    for( int i = 0; i < cache->Count(); i++ )
+        delete (P4GoSpecCache*)cache->Get( i );
+    cache->Clear();
 }
 
 //
@@ -386,32 +546,69 @@ P4GoSpecMgr::HaveSpecDef( const char* type )
 //
 
 P4GoSpecData*
-P4GoSpecMgr::StrDictToSpec( StrDict* dict, StrPtr* specDef )
+P4GoSpecMgr::StrDictToSpec( const char* type, StrDict* dict )
 {
 
-    // This converts it to a string, and then to a hash, so we go from one
-    // type of dictionary to another, via an intermediate form (a StrBuf).
+    // Rather than formatting the dict into a form and parsing it back,
+    // walk the elements of the specdef and copy each field across. That
+    // gives us the same normalised keys (the element tags, with an index
+    // for list fields) and drops anything the spec doesn't define, which
+    // is all the round trip ever bought us.
 
     Error e;
-    SpecDataTable dictData( dict );
-    Spec s( specDef->Text(), "", &e );
-    StrBuf form;
+    Spec* s = GetSpec( type, &e );
 
-    if( e.Test() )
+    if( !s )
         return 0;
 
-    // Format the StrDict into a StrBuf object
-    s.Format( &dictData, &form );
-
-    // Now parse the StrBuf into a new P4::Spec object
     P4GoSpecData* spec = new P4GoSpecData();
 
-    s.ParseNoValid( form.Text(), spec, &e );
+    for( int i = 0; i < s->Count(); i++ ) {
+        SpecElem* se = s->Get( i );
+
+        if( !se->IsList() ) {
+            StrPtr* val = dict->GetVar( se->tag );
+            if( val )
+                spec->SetLine( se, 0, val, &e );
+            continue;
+        }
+
+        // List fields are numbered from zero; the first gap ends the list.
+        // With array conversion on, they're gathered up into a list
+        // rather than copied key by key.
+        StrPtr* val;
+        if( convertArray ) {
+            int l = -1;
+            for( int x = 0; ( val = dict->GetVar( se->tag, x ) ); x++ ) {
+                if( l < 0 )
+                    l = spec->AddList( se->tag );
+                spec->AddListValue( l, *val );
+            }
+            continue;
+        }
+
+        for( int x = 0; ( val = dict->GetVar( se->tag, x ) ); x++ )
+            spec->SetLine( se, x, val, &e );
+    }
+
     if( e.Test() ) {
         delete spec;
         return 0;
     }
 
+    //
+    // Comments on list entries, such as a stream's PathsComment0, aren't
+    // elements of the specdef, so walk the dict for them. They're kept as
+    // plain numbered keys whether or not the lists themselves are
+    // gathered up, as the form parser would have left them. A comment on
+    // a line of its own can sit at an index with no entry, so they're
+    // not numbered from zero without gaps the way the lists are.
+    //
+    StrRef key, value;
+    for( int i = 0; dict->GetVar( i, key, value ); i++ )
+        if( IsListComment( s, key ) )
+            spec->Dict()->SetVar( key, value );
+
     // Now see if there are any extraTag fields as we'll need to
     // add those fields into our output. Just iterate over them
     // extracting the fields and inserting them as we go.
@@ -439,13 +636,12 @@ P4GoSpecMgr::StrDictToSpec( StrDict* dict, StrPtr* specDef )
 P4GoSpecData*
 P4GoSpecMgr::StringToSpec( const char* type, const char* form, Error* e )
 {
+    Spec* s = GetSpec( type, e );
+    if( !s )
+        return 0;
 
-    StrPtr* specDef = specs->GetVar( type );
     P4GoSpecData* specData = new P4GoSpecData;
-    Spec s( specDef->Text(), "", e );
-
-    if( !e->Test() )
-        s.ParseNoValid( form, specData, e );
+    s->ParseNoValid( form, specData, e );
 
     if( e->Test() ) {
         delete specData;
@@ -464,22 +660,19 @@ P4GoSpecMgr::SpecToString( const char* type,
                            StrBuf& b,
                            Error* e )
 {
-
-    StrBuf buf;
-    StrPtr* specDef = specs->GetVar( type );
-    if( !specDef ) {
+    if( !specs->Get( type ) ) {
         e->Set( E_FAILED,
                 "No specdef available. Cannot convert hash to a "
                 "Perforce form" );
         return;
     }
 
-    Spec s( specDef->Text(), "", e );
+    Spec* s = GetSpec( type, e );
 
-    if( e->Test() )
+    if( !s )
         return;
 
-    s.Format( spec, &b );
+    s->Format( spec, &b );
 }
 
 //
@@ -492,15 +685,19 @@ P4GoSpecMgr::SpecToString( const char* type,
 StrDict*
 P4GoSpecMgr::SpecFields( const char* type )
 {
-    return SpecFields( specs->GetVar( type ) );
+    Error e;
+    P4GoSpecCache* c = Entry( type, &e );
+    if( !c )
+        return 0;
+
+    if( !c->fields )
+        c->fields = SpecFields( c->spec );
+    return c->fields;
 }
 
 StrDict*
-P4GoSpecMgr::SpecFields( StrPtr* specDef )
+P4GoSpecMgr::SpecFields( Spec* s )
 {
-    if( !specDef )
-        return 0;
-
     //
     // Here we abuse the fact that SpecElem::tag is public, even though it's
     // only supposed to be public to SpecData's subclasses. It's hard to
@@ -508,18 +705,11 @@ P4GoSpecMgr::SpecFields( StrPtr* specDef )
     // reliable. So...
     //
     StrBufDict* hash = new StrBufDict();
-    Error e;
-
-    Spec s( specDef->Text(), "", &e );
-    if( e.Test() ) {
-        delete hash;
-        return 0;
-    }
 
-    for( int i = 0; i < s.Count(); i++ ) {
+    for( int i = 0; i < s->Count(); i++ ) {
         StrBuf k;
         StrBuf v;
-        SpecElem* se = s.Get( i );
+        SpecElem* se = s->Get( i );
 
         v = se->tag;
         k = v;
@@ -539,16 +729,53 @@ P4GoSpecMgr::SpecFields( StrPtr* specDef )
 void
 P4GoSpecMgr::SplitKey( const StrPtr* key, StrBuf& base, StrBuf& index )
 {
-    int i = 0;
+    int i = BaseLength( *key );
 
     base = *key;
     index = "";
-    for( i = key->Length(); i; i-- ) {
-        char prev = ( *key )[i - 1];
-        if( !isdigit( prev ) && prev != ',' ) {
-            base.Set( key->Text(), i );
-            index.Set( key->Text() + i );
-            break;
-        }
+    if( i ) {
+        base.Set( key->Text(), i );
+        index.Set( key->Text() + i );
+    }
+}
+
+//
+// The same split, without copying anything: returns the length of the
+// base name, or zero if the key is all index.
+//
+
+//
+// Is key the comment on an entry of one of the spec's lists: the list's
+// tag, then "Comment", then an index?
+//
+
+int
+P4GoSpecMgr::IsListComment( Spec* s, const StrPtr& key )
+{
+    static const int clen = 7; // strlen( "Comment" )
+
+    int len = BaseLength( key );
+    if( len <= clen || len == key.Length() ||
+        strncmp( key.Text() + len - clen, "Comment", clen ) )
+        return 0;
+
+    len -= clen;
+    for( int i = 0; i < s->Count(); i++ ) {
+        SpecElem* se = s->Get( i );
+        if( se->IsList() && se->tag.Length() == len &&
+            !strncmp( se->tag.Text(), key.Text(), len ) )
+            return 1;
+    }
+    return 0;
+}
+
+int
+P4GoSpecMgr::BaseLength( const StrPtr& key )
+{
+    for( int i = key.Length(); i; i-- ) {
+        char prev = key.Text()[i - 1];
+        if( !isdigit( prev ) && prev != ',' )
+            return i;
     }
+    return 0;
 }
@@ -26,6 +26,16 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 *******************************************************************************/
 
 class StrBufDict;
+class VarArray;
+class Spec;
+class P4GoSpecCache;
+class P4GoSpecSet;
+
+//
+// A parsed spec. With array conversion on, list fields such as a client's
+// View are kept as ordered lists of values instead of View0, View1, ...
+// in the dict, which is left holding only the single-valued fields.
+//
 
 class P4GoSpecData : public SpecDataTable
 {
@@ -33,6 +43,22 @@ class P4GoSpecData : public SpecDataTable
     P4GoSpecData( StrDict* dict = 0 );
     ~P4GoSpecData();
     StrBufDict* extras;
+
+    // Start a new list field, returning its index
+    int AddList( const StrPtr& tag );
+    void AddListValue( int l, const StrPtr& val );
+
+    int ListCount();
+    const StrPtr& ListTag( int l );
+    int ListLength( int l );
+    const StrPtr& ListValue( int l, int i );
+
+    // The whole spec as one dict, with any lists numbered out again
+    StrDict* Flat();
+
+  private:
+    VarArray* lists;
+    StrBufDict* flat;
 };
 
 class P4GoSpecMgr
@@ -41,11 +67,12 @@ class P4GoSpecMgr
     P4GoSpecMgr();
     ~P4GoSpecMgr();
 
-    void SetDebug( int i ) { debug = i; }
-
     void SetArrayConversion( int a ) { convertArray = a; }
 
-    // Clear the spec cache and revert to internal defaults
+    // The server whose specdefs we're learning; see P4GoSpecRegistry
+    void SetServer( const StrPtr& s ) { server = s; }
+
+    // Clear the spec cache and revert to the shared built-in specdefs
     void Reset();
 
     // Add a spec to the cache
@@ -70,25 +97,41 @@ class P4GoSpecMgr
     //
     // Convert a Perforce StrDict into a P4::Spec object. This is for
     // 2005.2 and later servers where the forms are supplied pre-parsed
-    // into a dictionary - we just need to convert them. The specDef
-    // argument tells us what type of spec we're converting.
+    // into a dictionary - we just need to convert them. The type
+    // argument tells us which specdef to use.
     //
-    P4GoSpecData* StrDictToSpec( StrDict* dict, StrPtr* specDef );
+    P4GoSpecData* StrDictToSpec( const char* type, StrDict* dict );
 
 
     //
     // Return a list of the fields in a given type of spec. Return null
-    // if the spec type is not known.
+    // if the spec type is not known. The dict belongs to the spec manager
+    // and lasts until the specdef for that type changes.
     //
     StrDict* SpecFields( const char* type );
 
+    //
+    // Return the parsed specdef for a type, parsing it on first use. The
+    // Spec belongs to the spec manager; null if the type is unknown or
+    // the specdef won't parse.
+    //
+    Spec* GetSpec( const char* type, Error* e );
+
+    // Length of the base name of an indexed key such as "how1,0"
+    static int BaseLength( const StrPtr& key );
+
   private:
     void SplitKey( const StrPtr* key, StrBuf& base, StrBuf& index );
     void* NewSpec( StrPtr* specDef );
-    StrDict* SpecFields( StrPtr* specDef );
+    StrDict* SpecFields( Spec* s );
+    static int IsListComment( Spec* s, const StrPtr& key );
+    P4GoSpecCache* Entry( const char* type, Error* e );
+    void Invalidate( const char* type );
+    void ClearCache();
 
   private:
-    int debug;
     int convertArray;
-    StrBufDict* specs;
+    StrBuf server;
+    P4GoSpecSet* specs;
+    VarArray* cache;
 };
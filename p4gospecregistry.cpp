@@ -0,0 +1,217 @@
+/*******************************************************************************
+
+Copyright (c) 2024, Perforce Software, Inc.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+#include <mutex>
+#include <p4/clientapi.h>
+#include <p4/vararray.h>
+#include "p4gohashindex.h"
+#include "p4gospecregistry.h"
+
+//
+// The registry itself: every published set, indexed by content hash and
+// guarded by one mutex.
+//
+
+static std::mutex registryLock;
+static VarArray* registry = 0;
+static P4GoHashIndex* registryIndex = 0;
+static P4GoSpecSet* builtin = 0;
+
+struct P4GoSpecEntry
+{
+    StrBuf type;
+    StrBuf def;
+};
+
+P4GoSpecSet::P4GoSpecSet( const StrPtr& s )
+{
+    server = s;
+    entries = new VarArray;
+    hash = 0;
+    refs = 0;
+}
+
+P4GoSpecSet::~P4GoSpecSet()
+{
+    for( int i = 0; i < entries->Count(); i++ )
+        delete (P4GoSpecEntry*)entries->Get( i );
+    delete entries;
+}
+
+int
+P4GoSpecSet::Find( const StrPtr& type )
+{
+    unsigned int h = P4GoHashIndex::Hash( type );
+    int pos = -1;
+    for( int i; ( i = index.Probe( h, pos ) ) >= 0; )
+        if( ( (P4GoSpecEntry*)entries->Get( i ) )->type == type )
+            return i;
+    return -1;
+}
+
+StrPtr*
+P4GoSpecSet::Get( const char* type )
+{
+    int i = Find( StrRef( type ) );
+    return i < 0 ? 0 : &( (P4GoSpecEntry*)entries->Get( i ) )->def;
+}
+
+//
+// The hash of a set is the XOR of the hashes of its entries, so that it
+// doesn't depend on the order the specdefs were learned in and can be
+// updated as entries are replaced.
+//
+
+void
+P4GoSpecSet::Set( const char* type, const char* specDef )
+{
+    StrRef t( type );
+    int i = Find( t );
+    P4GoSpecEntry* e;
+
+    if( i < 0 ) {
+        e = new P4GoSpecEntry;
+        e->type = t;
+        index.Insert( P4GoHashIndex::Hash( t ), entries->Count() );
+        entries->Put( e );
+    } else {
+        e = (P4GoSpecEntry*)entries->Get( i );
+        hash ^= EntryHash( e->type, e->def );
+    }
+
+    e->def = specDef;
+    hash ^= EntryHash( e->type, e->def );
+}
+
+int
+P4GoSpecSet::Same( P4GoSpecSet* other )
+{
+    if( hash != other->hash || server != other->server ||
+        entries->Count() != other->entries->Count() )
+        return 0;
+
+    for( int i = 0; i < entries->Count(); i++ ) {
+        P4GoSpecEntry* e = (P4GoSpecEntry*)entries->Get( i );
+        StrPtr* o = other->Get( e->type.Text() );
+        if( !o || *o != e->def )
+            return 0;
+    }
+    return 1;
+}
+
+unsigned int
+P4GoSpecSet::EntryHash( const StrPtr& type, const StrPtr& def )
+{
+    return ( P4GoHashIndex::Hash( type ) * 16777619u ) ^
+           P4GoHashIndex::Hash( def );
+}
+
+P4GoSpecSet*
+P4GoSpecRegistry::Builtin()
+{
+    std::lock_guard<std::mutex> lock( registryLock );
+
+    if( !builtin ) {
+        builtin = new P4GoSpecSet( StrRef::Null() );
+        for( struct specdata* sp = &speclist[0]; sp->type; sp++ )
+            builtin->Set( sp->type, sp->spec );
+        registry = new VarArray;
+        registryIndex = new P4GoHashIndex;
+        registryIndex->Insert( builtin->hash, registry->Count() );
+        registry->Put( builtin );
+    }
+    return builtin;
+}
+
+P4GoSpecSet*
+P4GoSpecRegistry::Update( P4GoSpecSet* base,
+                          const StrPtr& server,
+                          const char* type,
+                          const char* specDef )
+{
+    StrPtr* old = base->Get( type );
+    if( old && !strcmp( old->Text(), specDef ) )
+        return base;
+
+    // Build the candidate outside the lock; most of the time it's the
+    // first connection to the server that pays for this, and the rest
+    // find it already published.
+    P4GoSpecSet* next = new P4GoSpecSet( server );
+    for( int i = 0; i < base->entries->Count(); i++ ) {
+        P4GoSpecEntry* e = (P4GoSpecEntry*)base->entries->Get( i );
+        next->Set( e->type.Text(), e->def.Text() );
+    }
+    next->Set( type, specDef );
+
+    std::lock_guard<std::mutex> lock( registryLock );
+
+    int pos = -1;
+    for( int i; ( i = registryIndex->Probe( next->hash, pos ) ) >= 0; ) {
+        P4GoSpecSet* s = (P4GoSpecSet*)registry->Get( i );
+        if( s->Same( next ) ) {
+            delete next;
+            s->refs++;
+            return s;
+        }
+    }
+
+    registryIndex->Insert( next->hash, registry->Count() );
+    registry->Put( next );
+    next->refs++;
+    return next;
+}
+
+void
+P4GoSpecRegistry::Release( P4GoSpecSet* set )
+{
+    if( !set || set == builtin )
+        return;
+
+    std::lock_guard<std::mutex> lock( registryLock );
+
+    if( --set->refs > 0 )
+        return;
+
+    // Sets come and go rarely, and there are few of them, so the index
+    // is simply rebuilt without it
+    registryIndex->Clear();
+    for( int i = 0; i < registry->Count(); i++ ) {
+        if( registry->Get( i ) == set ) {
+            registry->Remove( i-- );
+            continue;
+        }
+        registryIndex->Insert( ( (P4GoSpecSet*)registry->Get( i ) )->hash, i );
+    }
+    delete set;
+}
+
+int
+P4GoSpecRegistry::Count()
+{
+    std::lock_guard<std::mutex> lock( registryLock );
+    return registry ? registry->Count() : 0;
+}
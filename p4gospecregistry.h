@@ -0,0 +1,105 @@
+/*******************************************************************************
+
+Copyright (c) 2024, Perforce Software, Inc.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+//
+// Specdefs are shared between every P4GoSpecMgr in the process. A
+// P4GoSpecSet is one complete collection of specdefs, keyed by spec type;
+// once published by the registry it is never changed, so any number of
+// connections can read it without locking. A connection that learns a
+// new specdef from its server asks the registry for the set with that
+// one definition replaced: if another connection to the same server has
+// already got there, it gets that set, otherwise a copy is made and
+// published. Sets are identified by server address and a hash of their
+// contents. Each connection holds a reference to the set it uses, and a
+// set is dropped when the last is released, so the sets a connection
+// passed through on its way to its own don't pile up; the built-in set
+// is kept for the life of the process.
+//
+
+class VarArray;
+
+// The built-in specdefs, generated into p4gospecmgr.cpp
+struct specdata
+{
+    const char* type;
+    const char* spec;
+};
+
+extern struct specdata speclist[];
+
+class P4GoSpecSet
+{
+  public:
+    // The specdef for a type, or null if the set doesn't have one
+    StrPtr* Get( const char* type );
+
+    const StrPtr& Server() { return server; }
+    unsigned int Hash() { return hash; }
+
+  private:
+    friend class P4GoSpecRegistry;
+
+    P4GoSpecSet( const StrPtr& server );
+    ~P4GoSpecSet();
+
+    int Find( const StrPtr& type );
+    void Set( const char* type, const char* specDef );
+    int Same( P4GoSpecSet* other );
+
+    static unsigned int EntryHash( const StrPtr& type, const StrPtr& def );
+
+  private:
+    StrBuf server;
+    VarArray* entries;
+    P4GoHashIndex index; // entry positions by type
+    unsigned int hash;
+    int refs; // guarded by the registry's lock
+};
+
+class P4GoSpecRegistry
+{
+  public:
+    // The built-in specdefs that every connection starts with
+    static P4GoSpecSet* Builtin();
+
+    //
+    // The set that is the same as base apart from the specdef for type,
+    // as seen on the given server. Returns base if nothing would change;
+    // otherwise the caller gets a reference to the set returned, and
+    // should release the one it has to base.
+    //
+    static P4GoSpecSet* Update( P4GoSpecSet* base,
+                                const StrPtr& server,
+                                const char* type,
+                                const char* specDef );
+
+    // Give up a reference from Update(); null and the built-in are ignored
+    static void Release( P4GoSpecSet* set );
+
+    // How many sets are published
+    static int Count();
+};
@@ -0,0 +1,170 @@
+/*******************************************************************************
+
+Copyright (c) 2024, Perforce Software, Inc.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <string.h>
+#include <p4/clientapi.h>
+#include "p4goencode.h"
+#include "p4gotrace.h"
+
+struct P4GoTrace::Slot
+{
+    // 0 while being written, otherwise the event's number + 1
+    std::atomic<unsigned long long> seq;
+    std::atomic<long long> time;
+    std::atomic<long long> size;
+    std::atomic<int> type;
+    std::atomic<int> arg;
+    std::atomic<unsigned long long> command[3];
+};
+
+P4GoTrace::P4GoTrace()
+  : slots( 0 )
+  , mask( 0 )
+  , next( 0 )
+{
+    for( int i = 0; i < 3; i++ )
+        command[i].store( 0 );
+}
+
+P4GoTrace::~P4GoTrace()
+{
+    delete[] slots;
+}
+
+void
+P4GoTrace::SetSize( int size )
+{
+    delete[] slots;
+    slots = 0;
+    mask = 0;
+    next.store( 0 );
+
+    if( size <= 0 )
+        return;
+
+    unsigned int n = 1;
+    while( n < (unsigned int)size && n < 0x40000000 )
+        n <<= 1;
+
+    slots = new Slot[n];
+    for( unsigned int i = 0; i < n; i++ )
+        slots[i].seq.store( 0 );
+    mask = n - 1;
+}
+
+void
+P4GoTrace::Clear()
+{
+    if( !slots )
+        return;
+    for( unsigned int i = 0; i <= mask; i++ )
+        slots[i].seq.store( 0 );
+    next.store( 0 );
+}
+
+void
+P4GoTrace::SetCommand( const char* cmd )
+{
+    unsigned long long w[3] = { 0, 0, 0 };
+    strncpy( (char*)w, cmd, sizeof( w ) );
+    for( int i = 0; i < 3; i++ )
+        command[i].store( w[i], std::memory_order_relaxed );
+}
+
+void
+P4GoTrace::Put( int type, int arg, long long size )
+{
+    using namespace std::chrono;
+
+    unsigned long long n = next.fetch_add( 1, std::memory_order_relaxed );
+    Slot& s = slots[n & mask];
+
+    s.seq.store( 0, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
+
+    s.time.store(
+      duration_cast<microseconds>( system_clock::now().time_since_epoch() )
+        .count(),
+      std::memory_order_relaxed );
+    s.size.store( size, std::memory_order_relaxed );
+    s.type.store( type, std::memory_order_relaxed );
+    s.arg.store( arg, std::memory_order_relaxed );
+    for( int i = 0; i < 3; i++ )
+        s.command[i].store( command[i].load( std::memory_order_relaxed ),
+                            std::memory_order_relaxed );
+
+    s.seq.store( n + 1, std::memory_order_release );
+}
+
+const StrPtr&
+P4GoTrace::Dump()
+{
+    P4GoEncoder enc( dumped );
+
+    dumped.Clear();
+    int at = enc.Mark();
+    if( !slots )
+        return dumped;
+
+    unsigned long long end = next.load( std::memory_order_acquire );
+    unsigned long long n = end > mask + 1 ? end - ( mask + 1 ) : 0;
+    int count = 0;
+
+    for( ; n < end; n++ ) {
+        Slot& s = slots[n & mask];
+
+        unsigned long long seq = s.seq.load( std::memory_order_acquire );
+        if( seq != n + 1 )
+            continue;
+
+        long long time = s.time.load( std::memory_order_relaxed );
+        long long size = s.size.load( std::memory_order_relaxed );
+        int type = s.type.load( std::memory_order_relaxed );
+        int arg = s.arg.load( std::memory_order_relaxed );
+        unsigned long long w[3];
+        for( int i = 0; i < 3; i++ )
+            w[i] = s.command[i].load( std::memory_order_relaxed );
+
+        // Rewritten while we read it
+        std::atomic_thread_fence( std::memory_order_acquire );
+        if( s.seq.load( std::memory_order_relaxed ) != seq )
+            continue;
+
+        const char* cmd = (const char*)w;
+        enc.PutI64( time );
+        enc.PutU32( type );
+        enc.PutU32( arg );
+        enc.PutI64( size );
+        enc.PutStr( cmd, strnlen( cmd, sizeof( w ) ) );
+        count++;
+    }
+
+    enc.SetU32( at, count );
+    return dumped;
+}
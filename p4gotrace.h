@@ -0,0 +1,112 @@
+/*******************************************************************************
+
+Copyright (c) 2024, Perforce Software, Inc.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+//
+// P4GoTrace keeps the last so many trace events of a connection in a
+// ring, in place of writing debug output to stderr. An event is a few
+// numbers: what happened, when, a size and an argument that depend on
+// what happened, and the command being run. Recording one takes a clock
+// read and a handful of stores, so tracing can be left on in production
+// and the ring dumped when something goes wrong.
+//
+// Recording is lock-free, and safe from any thread: each event claims a
+// slot with an atomic increment and publishes it with a sequence number,
+// which Dump() checks either side of reading the slot, so that a slot
+// being rewritten is skipped rather than read torn. SetSize() must not be
+// called while a command runs.
+//
+// Dump() packs the events, oldest first, as:
+//
+//     u32 count, count x ( i64 time, u32 type, u32 arg, i64 size,
+//                          string cmd )
+//
+// where time is in microseconds since the Unix epoch.
+//
+
+enum P4GoTraceType
+{
+    TE_RUN,         // size: arguments
+    TE_END,         // size: results
+    TE_TEXT,        // size: bytes
+    TE_BINARY,      // size: bytes
+    TE_STAT,
+    TE_SPEC,
+    TE_TRACK,       // size: lines
+    TE_MESSAGE,     // arg: severity
+    TE_ERROR,       // arg: severity
+    TE_FILTERED,
+    TE_HANDLER,     // arg: what the handler returned
+    TE_FLUSH,       // arg: what the stream returned; size: results
+    TE_INPUT,       // size: bytes
+    TE_PROMPT,
+    TE_RESOLVE,     // arg: 1 for an action resolve
+    TE_DIFF,
+    TE_PROGRESS,    // arg: progress type
+    TE_CONNECT,     // arg: 1 if it succeeded
+    TE_DISCONNECT,
+    TE_RECONNECT,   // arg: attempt; size: delay in ms
+    TE_TRANSFER,    // arg: threads
+    TE_CHARSET,
+};
+
+class P4GoTrace
+{
+  public:
+    P4GoTrace();
+    ~P4GoTrace();
+
+    // Keep the last size events, rounded up to a power of two; 0 stops
+    // tracing and frees the ring.
+    void SetSize( int size );
+    int GetSize() { return mask ? mask + 1 : 0; }
+
+    // The command that the events to come belong to
+    void SetCommand( const char* cmd );
+
+    void Record( int type, int arg = 0, long long size = 0 )
+    {
+        if( slots )
+            Put( type, arg, size );
+    }
+
+    // The buffer belongs to us, and lasts until the next Dump()
+    const StrPtr& Dump();
+
+    void Clear();
+
+  private:
+    struct Slot;
+
+    void Put( int type, int arg, long long size );
+
+  private:
+    Slot* slots;
+    unsigned int mask;
+    std::atomic<unsigned long long> next;
+    std::atomic<unsigned long long> command[3]; // up to 24 bytes of name
+    StrBuf dumped;
+};
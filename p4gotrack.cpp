@@ -0,0 +1,192 @@
+/*******************************************************************************
+
+Copyright (c) 2024, Perforce Software, Inc.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+#include <p4/clientapi.h>
+#include <p4/vararray.h>
+#include "p4goencode.h"
+#include "p4gotrack.h"
+
+P4GoTrack::P4GoTrack()
+{
+    tables = new VarArray;
+    Clear();
+}
+
+P4GoTrack::~P4GoTrack()
+{
+    Clear();
+    delete tables;
+}
+
+void
+P4GoTrack::Clear()
+{
+    for( int i = 0; i < tables->Count(); i++ )
+        delete (Table*)tables->Get( i );
+    tables->Clear();
+
+    commands = 0;
+    lapse = 0;
+    for( int i = 0; i < TR_FIELDS; i++ )
+        rpc[i] = 0;
+    current = 0;
+}
+
+P4GoTrack::Table*
+P4GoTrack::Find( const StrPtr& name )
+{
+    for( int i = 0; i < tables->Count(); i++ ) {
+        Table* t = (Table*)tables->Get( i );
+        if( t->name == name )
+            return t;
+    }
+
+    Table* t = new Table;
+    t->name = name;
+    for( int i = 0; i < TT_FIELDS; i++ )
+        t->v[i] = 0;
+    tables->Put( t );
+    return t;
+}
+
+static P4INT64
+Millis( double seconds )
+{
+    return (P4INT64)( seconds * 1000 + 0.5 );
+}
+
+void
+P4GoTrack::Parse( const StrPtr& l )
+{
+    StrBuf line( l ); // for sscanf(), which wants it terminated
+    const char* s = line.Text();
+    long long a, b, c, d, e, f, g;
+    double x, y;
+
+    // A table's lines are indented; anything else ends the table
+    if( *s != ' ' )
+        current = 0;
+
+    if( sscanf( s, "lapse %lfs", &x ) == 1 ) {
+        commands++;
+        lapse += Millis( x );
+    } else if( sscanf( s,
+                       "rpc msgs/size in+out %lld+%lld/%lldmb+%lldmb",
+                       &a, &b, &c, &d ) == 4 ) {
+        rpc[TR_MSGS_IN] += a;
+        rpc[TR_MSGS_OUT] += b;
+        rpc[TR_SIZE_IN] += c;
+        rpc[TR_SIZE_OUT] += d;
+
+        const char* t = strstr( s, "snd/rcv " );
+        if( t && sscanf( t, "snd/rcv %lfs/%lfs", &x, &y ) == 2 ) {
+            rpc[TR_SEND_TIME] += Millis( x );
+            rpc[TR_RECV_TIME] += Millis( y );
+        }
+    } else if( !strncmp( s, "db.", 3 ) ) {
+        int n = 0;
+        while( s[n] && s[n] != ' ' )
+            n++;
+        current = Find( StrRef( s, n ) );
+    } else if( !current ) {
+        return;
+    } else if( sscanf( s, " pages in+out+cached %lld+%lld+%lld",
+                       &a, &b, &c ) == 3 ) {
+        current->v[TT_PAGES_IN] += a;
+        current->v[TT_PAGES_OUT] += b;
+        current->v[TT_PAGES_CACHED] += c;
+    } else if( sscanf( s,
+                       " locks read/write %lld/%lld rows get+pos+scan"
+                       " put+del %lld+%lld+%lld %lld+%lld",
+                       &a, &b, &c, &d, &e, &f, &g ) == 7 ) {
+        current->v[TT_READ_LOCKS] += a;
+        current->v[TT_WRITE_LOCKS] += b;
+        current->v[TT_GET_ROWS] += c;
+        current->v[TT_POS_ROWS] += d;
+        current->v[TT_SCAN_ROWS] += e;
+        current->v[TT_PUT_ROWS] += f;
+        current->v[TT_DEL_ROWS] += g;
+    } else if( sscanf( s,
+                       " total lock wait+held read/write"
+                       " %lldms+%lldms/%lldms+%lldms",
+                       &a, &b, &c, &d ) == 4 ) {
+        current->v[TT_READ_WAIT] += a;
+        current->v[TT_READ_HELD] += b;
+        current->v[TT_WRITE_WAIT] += c;
+        current->v[TT_WRITE_HELD] += d;
+    } else if( sscanf( s,
+                       " max lock wait+held read/write"
+                       " %lldms+%lldms/%lldms+%lldms",
+                       &a, &b, &c, &d ) == 4 ) {
+        long long m[4] = { a, b, c, d };
+        for( int i = 0; i < 4; i++ )
+            if( m[i] > current->v[TT_MAX_READ_WAIT + i] )
+                current->v[TT_MAX_READ_WAIT + i] = m[i];
+    }
+}
+
+void
+P4GoTrack::Add( P4GoTrack& o )
+{
+    commands += o.commands;
+    lapse += o.lapse;
+    for( int i = 0; i < TR_FIELDS; i++ )
+        rpc[i] += o.rpc[i];
+
+    for( int i = 0; i < o.tables->Count(); i++ ) {
+        Table* from = (Table*)o.tables->Get( i );
+        Table* to = Find( from->name );
+
+        for( int f = 0; f < TT_MAX_READ_WAIT; f++ )
+            to->v[f] += from->v[f];
+        for( int f = TT_MAX_READ_WAIT; f < TT_FIELDS; f++ )
+            if( from->v[f] > to->v[f] )
+                to->v[f] = from->v[f];
+    }
+}
+
+const StrPtr&
+P4GoTrack::Pack()
+{
+    P4GoEncoder enc( packed );
+
+    packed.Clear();
+    enc.PutU32( commands );
+    enc.PutI64( lapse );
+    for( int i = 0; i < TR_FIELDS; i++ )
+        enc.PutI64( rpc[i] );
+
+    enc.PutU32( tables->Count() );
+    for( int i = 0; i < tables->Count(); i++ ) {
+        Table* t = (Table*)tables->Get( i );
+        enc.PutStr( t->name );
+        for( int f = 0; f < TT_FIELDS; f++ )
+            enc.PutI64( t->v[f] );
+    }
+
+    return packed;
+}
@@ -0,0 +1,120 @@
+/*******************************************************************************
+
+Copyright (c) 2024, Perforce Software, Inc.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+//
+// P4GoTrack parses the performance data that -Ztrack adds to a command's
+// output, a line at a time as P4GoClientUser separates it out, without
+// the leading "--- ":
+//
+//     lapse .044s
+//     rpc msgs/size in+out 2+3/0mb+0mb himarks 795416/795416 snd/rcv .000s/.000s
+//     db.rev
+//       pages in+out+cached 4+0+3
+//       locks read/write 1/0 rows get+pos+scan put+del 0+1+3 0+0
+//       total lock wait+held read/write 0ms+1ms/0ms+0ms
+//       max lock wait+held read/write 0ms+1ms/0ms+0ms
+//
+// Lines it doesn't know are skipped. The figures of each command parsed
+// are added to those before, so one P4GoTrack sums up a run of several
+// commands, and Add() sums up runs; maximums take the larger. Times are
+// in milliseconds and sizes in megabytes, as the server reports them.
+//
+// Pack() lays the figures out as:
+//
+//     u32 commands, 7 x i64 ( lapse, rpc msgs in, out, size in, out,
+//                             send time, receive time )
+//     u32 tables, tables x ( string name, 18 x i64 table fields )
+//
+// with the table fields in the order of P4GoTrackField.
+//
+
+enum P4GoTrackField
+{
+    TT_PAGES_IN,
+    TT_PAGES_OUT,
+    TT_PAGES_CACHED,
+    TT_READ_LOCKS,
+    TT_WRITE_LOCKS,
+    TT_GET_ROWS,
+    TT_POS_ROWS,
+    TT_SCAN_ROWS,
+    TT_PUT_ROWS,
+    TT_DEL_ROWS,
+    TT_READ_WAIT,
+    TT_READ_HELD,
+    TT_WRITE_WAIT,
+    TT_WRITE_HELD,
+    TT_MAX_READ_WAIT,
+    TT_MAX_READ_HELD,
+    TT_MAX_WRITE_WAIT,
+    TT_MAX_WRITE_HELD,
+    TT_FIELDS
+};
+
+enum P4GoTrackRpc
+{
+    TR_MSGS_IN,
+    TR_MSGS_OUT,
+    TR_SIZE_IN,
+    TR_SIZE_OUT,
+    TR_SEND_TIME,
+    TR_RECV_TIME,
+    TR_FIELDS
+};
+
+class P4GoTrack
+{
+  public:
+    P4GoTrack();
+    ~P4GoTrack();
+
+    void Clear();
+    void Parse( const StrPtr& line );
+    void Add( P4GoTrack& other );
+
+    int Commands() { return commands; }
+
+    // The buffer belongs to us, and lasts until the next Pack()
+    const StrPtr& Pack();
+
+  private:
+    struct Table
+    {
+        StrBuf name;
+        P4INT64 v[TT_FIELDS];
+    };
+
+    Table* Find( const StrPtr& name );
+
+  private:
+    int commands;
+    P4INT64 lapse;
+    P4INT64 rpc[TR_FIELDS];
+    VarArray* tables;
+    Table* current; // the table the lines being parsed are about
+    StrBuf packed;
+};
@@ -0,0 +1,325 @@
+/*******************************************************************************
+
+Copyright (c) 2024, Perforce Software, Inc.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <p4/clientapi.h>
+#include <p4/clientprog.h>
+#include <p4/strarray.h>
+#include <p4/vararray.h>
+#include <p4/spec.h>
+#include "p4gospecmgr.h"
+#include "p4goarena.h"
+#include "p4gohashindex.h"
+#include "p4gokeytable.h"
+#include "p4goresult.h"
+#include "p4gomergedata.h"
+#include "p4gometrics.h"
+#include "p4gotrace.h"
+#include "p4goclientuser.h"
+#include "p4goclientapi.h"
+#include "p4gotransfer.h"
+
+//
+// The progress of a transfer, as the command's handler sees it: one
+// indicator, started by the first worker to report, whose total and
+// position are the sums of those of every worker's indicators, and which
+// is done when the transfer is. The handler calls into Go and isn't
+// written for more than one caller at a time, so the workers take turns.
+// The command's thread is waiting for them meanwhile, so the time spent
+// in the handler is metered for it as its own callbacks are.
+//
+
+class P4GoTransferProgress
+{
+  public:
+    P4GoTransferProgress( P4GoClientUser* ui )
+      : ui( ui ), started( 0 ), described( 0 ), failed( 0 ), total( 0 ),
+        position( 0 )
+    {
+        progress = ui->GetProgress();
+    }
+
+    int Active() { return progress != 0; }
+
+    void Start( int type )
+    {
+        std::lock_guard<std::mutex> lock( mutex );
+        if( started )
+            return;
+        started = 1;
+
+        long long t = P4GoMeter::Now();
+        progress->Init( type );
+        ui->Crossed( t );
+    }
+
+    void Description( const StrPtr* d, int u )
+    {
+        std::lock_guard<std::mutex> lock( mutex );
+        if( described )
+            return;
+        described = 1;
+
+        long long t = P4GoMeter::Now();
+        progress->Description( d, u );
+        ui->Crossed( t );
+    }
+
+    void Add( long t, long u )
+    {
+        std::lock_guard<std::mutex> lock( mutex );
+        total += t;
+        position += u;
+
+        long long now = P4GoMeter::Now();
+        if( t )
+            progress->Total( total );
+        if( u )
+            progress->Update( position );
+        ui->Crossed( now );
+    }
+
+    void Failed()
+    {
+        std::lock_guard<std::mutex> lock( mutex );
+        failed = 1;
+    }
+
+    // Once the workers have finished
+    void Done()
+    {
+        if( !started )
+            return;
+
+        long long t = P4GoMeter::Now();
+        progress->Done( failed );
+        ui->Crossed( t );
+    }
+
+  private:
+    std::mutex mutex;
+    P4GoClientUser* ui;
+    P4GoProgress* progress;
+    int started;
+    int described;
+    int failed;
+    long total;
+    long position;
+};
+
+//
+// One of a worker's indicators, which passes on how far it has moved.
+//
+
+class P4GoWorkerProgress : public ClientProgress
+{
+  public:
+    P4GoWorkerProgress( P4GoTransferProgress* p, int type )
+      : progress( p ), total( 0 ), position( 0 )
+    {
+        progress->Start( type );
+    }
+
+    void Description( const StrPtr* d, int u ) { progress->Description( d, u ); }
+
+    void Total( long t )
+    {
+        progress->Add( t - total, 0 );
+        total = t;
+    }
+
+    int Update( long u )
+    {
+        progress->Add( 0, u - position );
+        position = u;
+        return 0;
+    }
+
+    void Done( int f )
+    {
+        if( f )
+            progress->Failed();
+    }
+
+  private:
+    P4GoTransferProgress* progress;
+    long total;
+    long position;
+};
+
+//
+// The UI of one worker: it keeps its messages for the parent, and passes
+// progress on.
+//
+
+class P4GoTransferUser : public ClientUser
+{
+  public:
+    P4GoTransferUser( P4GoTransferProgress* p ) : progress( p ), failed( 0 ) {}
+
+    ~P4GoTransferUser()
+    {
+        for( int i = 0; i < messages.Count(); i++ )
+            delete (Error*)messages.Get( i );
+    }
+
+    void HandleError( Error* err ) { Keep( err ); }
+    void Message( Error* err ) { Keep( err ); }
+
+    // Transfers have nothing to say beyond their messages
+    void OutputInfo( char, const char* ) {}
+    void OutputText( const char*, int ) {}
+    void OutputBinary( const char*, int ) {}
+    void OutputStat( StrDict* ) {}
+
+    ClientProgress* CreateProgress( int type )
+    {
+        return progress->Active() ? new P4GoWorkerProgress( progress, type ) : 0;
+    }
+
+    int ProgressIndicator() { return progress->Active(); }
+
+    void Keep( Error* err )
+    {
+        Error* copy = new Error;
+        *copy = *err;
+        messages.Put( copy );
+        if( err->GetSeverity() >= E_FAILED )
+            failed++;
+    }
+
+  public:
+    P4GoTransferProgress* progress;
+    VarArray messages;
+    int failed;
+    Error error; // from connecting or disconnecting
+};
+
+P4GoTransfer::P4GoTransfer( P4GoClientApi* a )
+{
+    api = a;
+}
+
+//
+// A worker's connection has been set up as the API's is; it adds the
+// protocol variables the server gave for the transfer.
+//
+
+static void
+RunWorker( ClientApi* client,
+           KeepAlive* keepAlive,
+           P4GoTransferUser* ui,
+           const char* cmd,
+           StrArray* args,
+           StrDict* pVars )
+{
+    StrRef var, val;
+    for( int i = 0; pVars->GetVar( i, var, val ); i++ )
+        client->SetProtocol( var.Text(), val.Text() );
+
+    client->Init( &ui->error );
+    if( ui->error.Test() )
+        return;
+
+    // Cancelling the parent's command stops the workers too
+    client->SetBreak( keepAlive );
+
+    char** argv = new char*[args->Count() + 1];
+    for( int i = 0; i < args->Count(); i++ )
+        argv[i] = args->Get( i )->Text();
+    argv[args->Count()] = 0;
+
+    client->SetArgv( args->Count(), argv );
+    client->Run( cmd, ui );
+    client->Final( &ui->error );
+
+    delete[] argv;
+}
+
+int
+P4GoTransfer::Transfer( ClientApi* client,
+                        ClientUser* ui,
+                        const char* cmd,
+                        StrArray& args,
+                        StrDict& pVars,
+                        int threads,
+                        Error* e )
+{
+    P4GoClientUser* parent = (P4GoClientUser*)ui;
+    parent->Trace( TE_TRANSFER, threads );
+
+    P4GoTransferProgress progress( parent );
+    std::vector<ClientApi*> clients;
+    std::vector<P4GoTransferUser*> users;
+    std::vector<std::thread> workers;
+
+    // The connections are set up here, as the API isn't to be read from
+    // more than one thread
+    for( int i = 0; i < threads; i++ ) {
+        clients.push_back( new ClientApi );
+        users.push_back( new P4GoTransferUser( &progress ) );
+        api->SetupWorker( *clients[i], &users[i]->error );
+    }
+
+    for( int i = 0; i < threads; i++ ) {
+        if( users[i]->error.Test() )
+            continue;
+        workers.push_back( std::thread( RunWorker, clients[i], parent, users[i],
+                                        cmd, &args, &pVars ) );
+    }
+
+    for( size_t i = 0; i < workers.size(); i++ )
+        workers[i].join();
+
+    progress.Done();
+
+    // Back on the parent's thread, hand on what the workers had to say
+    int failed = 0;
+    for( size_t i = 0; i < users.size(); i++ ) {
+        P4GoTransferUser* u = users[i];
+
+        for( int m = 0; m < u->messages.Count(); m++ )
+            ui->HandleError( (Error*)u->messages.Get( m ) );
+
+        if( u->error.Test() )
+            ui->HandleError( &u->error );
+        if( u->error.Test() || u->failed )
+            failed++;
+
+        delete u;
+        delete clients[i];
+    }
+
+    if( failed )
+        e->Set( E_FAILED, "P4#transfer - %count% parallel transfer thread(s) failed." )
+            << failed;
+
+    return failed ? 1 : 0;
+}
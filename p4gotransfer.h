@@ -0,0 +1,57 @@
+/*******************************************************************************
+
+Copyright (c) 2024, Perforce Software, Inc.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+//
+// P4GoTransfer does the file transfers of "sync --parallel", "submit
+// --parallel" and the like inside the process, rather than leaving the
+// client to fork p4 processes. The client hands it the command each
+// worker is to run; each worker thread makes its own connection to the
+// same server, set up as the API's own is, runs the command, and keeps
+// the messages it gets. When they have all finished the messages are
+// passed to the UI of the command, worker by worker, so they end up in
+// its result set. The workers' progress is added up into one indicator
+// for the command's progress handler as it happens.
+//
+
+class P4GoClientApi;
+
+class P4GoTransfer : public ClientTransfer
+{
+  public:
+    P4GoTransfer( P4GoClientApi* api );
+
+    int Transfer( ClientApi* client,
+                  ClientUser* ui,
+                  const char* cmd,
+                  StrArray& args,
+                  StrDict& pVars,
+                  int threads,
+                  Error* e );
+
+  private:
+    P4GoClientApi* api;
+};
@@ -0,0 +1,445 @@
+/*******************************************************************************
+
+Copyright (c) 2024, Perforce Software, Inc.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+package p4
+
+import (
+	"bufio"
+	"fmt"
+	"io"
+	"math"
+	"sort"
+	"strconv"
+	"strings"
+	"sync"
+	"time"
+)
+
+// P4MetricsRegistry gathers the metrics of the commands run by any number
+// of P4 instances (see SetMetricsRegistry), and the occupancy of pools,
+// and writes them out in the OpenMetrics text format for a scraper to
+// pick up. It is safe for concurrent use.
+//
+// For each command name it keeps a histogram of run times and of the
+// time to the first output, counters of the output received and of the
+// time spent in handlers, and, for runs made in track mode, the lock
+// wait and held times of each database table.
+type P4MetricsRegistry struct {
+	mu       sync.Mutex
+	buckets  []float64 // upper bounds, in seconds
+	commands map[string]*p4CommandStats
+	tables   map[p4TableKey]*p4TableStats
+	pools    map[string]*P4Pool
+}
+
+type p4CommandStats struct {
+	duration    p4Histogram
+	firstRecord p4Histogram
+	records     [P4RESULTTYPE_SPEC + 1]int64
+	textBytes   int64
+	binaryBytes int64
+	handler     time.Duration
+	crossings   int64
+	reconnects  int64
+}
+
+type p4TableKey struct {
+	cmd   string
+	table string
+}
+
+type p4TableStats struct {
+	readWait, readHeld, writeWait, writeHeld             time.Duration
+	maxReadWait, maxReadHeld, maxWriteWait, maxWriteHeld time.Duration
+	scanRows                                             int64
+}
+
+type p4Histogram struct {
+	counts []int64 // by bucket, not cumulative; the last is +Inf
+	sum    float64
+	count  int64
+}
+
+// clone copies the stats, histogram buckets and all
+func (c *p4CommandStats) clone() p4CommandStats {
+	n := *c
+	n.duration.counts = append([]int64(nil), c.duration.counts...)
+	n.firstRecord.counts = append([]int64(nil), c.firstRecord.counts...)
+	return n
+}
+
+// DefaultMetricsBuckets are the histogram bounds, in seconds, used by
+// NewMetricsRegistry.
+var DefaultMetricsBuckets = []float64{
+	.001, .0025, .005, .01, .025, .05, .1, .25, .5, 1, 2.5, 5, 10, 30, 60,
+}
+
+// NewMetricsRegistry makes an empty registry with histogram bounds of
+// buckets seconds, or DefaultMetricsBuckets if none are given.
+func NewMetricsRegistry(buckets ...float64) *P4MetricsRegistry {
+	if len(buckets) == 0 {
+		buckets = DefaultMetricsBuckets
+	}
+	buckets = append([]float64(nil), buckets...)
+	sort.Float64s(buckets)
+	return &P4MetricsRegistry{
+		buckets:  buckets,
+		commands: make(map[string]*p4CommandStats),
+		tables:   make(map[p4TableKey]*p4TableStats),
+		pools:    make(map[string]*P4Pool),
+	}
+}
+
+// SetMetricsRegistry has this P4 record every command it runs in r, or
+// stops it recording if r is nil. Runs made in track mode record the
+// lock times too.
+func (p4 *P4) SetMetricsRegistry(r *P4MetricsRegistry) {
+	p4.registry = r
+}
+
+// observe records the run just made, if there's a registry
+func (p4 *P4) observe(cmd string) {
+	if p4.registry == nil {
+		return
+	}
+	m := p4.Metrics()
+	var track *P4TrackData
+	if p4.Track() {
+		t := p4.TrackData()
+		track = &t
+	}
+	p4.registry.Observe(cmd, m, track)
+}
+
+// observeBatch records each of the first sent commands of the batch just
+// run as a run of its own, under its own name. Their times overlap, as
+// the commands were pipelined.
+func (p4 *P4) observeBatch(cmds []P4BatchCommand, sent int) {
+	if p4.registry == nil {
+		return
+	}
+	for i := 0; i < sent; i++ {
+		var track *P4TrackData
+		if p4.Track() {
+			t := p4.batchTrackData(i)
+			track = &t
+		}
+		p4.registry.Observe(cmds[i].Cmd, p4.batchMetrics(i), track)
+	}
+}
+
+// Observe records a run of cmd, with its track data if there is any. P4
+// instances with the registry set call it for every run; it is there for
+// callers that gather metrics some other way.
+func (r *P4MetricsRegistry) Observe(cmd string, m P4Metrics, track *P4TrackData) {
+	r.mu.Lock()
+	defer r.mu.Unlock()
+
+	c := r.commands[cmd]
+	if c == nil {
+		c = &p4CommandStats{
+			duration:    p4Histogram{counts: make([]int64, len(r.buckets)+1)},
+			firstRecord: p4Histogram{counts: make([]int64, len(r.buckets)+1)},
+		}
+		r.commands[cmd] = c
+	}
+	r.observe(&c.duration, m.Total)
+	if m.FirstRecord > 0 {
+		r.observe(&c.firstRecord, m.FirstRecord)
+	}
+	for i, n := range m.Records {
+		c.records[i] += n
+	}
+	c.textBytes += m.TextBytes
+	c.binaryBytes += m.BinaryBytes
+	c.handler += m.HandlerTime
+	c.crossings += m.Crossings
+	c.reconnects += m.Reconnects
+
+	if track == nil {
+		return
+	}
+	for _, tt := range track.Tables {
+		key := p4TableKey{cmd, tt.Name}
+		t := r.tables[key]
+		if t == nil {
+			t = &p4TableStats{}
+			r.tables[key] = t
+		}
+		t.readWait += tt.ReadWait
+		t.readHeld += tt.ReadHeld
+		t.writeWait += tt.WriteWait
+		t.writeHeld += tt.WriteHeld
+		t.maxReadWait = max(t.maxReadWait, tt.MaxReadWait)
+		t.maxReadHeld = max(t.maxReadHeld, tt.MaxReadHeld)
+		t.maxWriteWait = max(t.maxWriteWait, tt.MaxWriteWait)
+		t.maxWriteHeld = max(t.maxWriteHeld, tt.MaxWriteHeld)
+		t.scanRows += tt.ScanRows
+	}
+}
+
+func (r *P4MetricsRegistry) observe(h *p4Histogram, d time.Duration) {
+	v := d.Seconds()
+	h.counts[sort.SearchFloat64s(r.buckets, v)]++
+	h.sum += v
+	h.count++
+}
+
+// AddPool has the registry report the occupancy of pool under name, or
+// stop reporting it if pool is nil.
+func (r *P4MetricsRegistry) AddPool(name string, pool *P4Pool) {
+	r.mu.Lock()
+	defer r.mu.Unlock()
+	if pool == nil {
+		delete(r.pools, name)
+	} else {
+		r.pools[name] = pool
+	}
+}
+
+var p4ResultTypeNames = [...]string{"string", "binary", "track", "dict", "message", "spec"}
+
+// WriteTo writes everything recorded so far to w in the OpenMetrics text
+// format, ending with "# EOF". Samples are in a stable order, so that
+// successive files can be compared.
+func (r *P4MetricsRegistry) WriteTo(w io.Writer) (int64, error) {
+	cw := &p4CountingWriter{w: bufio.NewWriter(w)}
+	mw := &p4MetricsWriter{w: cw}
+
+	// Copy everything out under the lock, so that a slow writer doesn't
+	// hold up the runs recording into the registry
+	r.mu.Lock()
+	cmds := make([]string, 0, len(r.commands))
+	for cmd := range r.commands {
+		cmds = append(cmds, cmd)
+	}
+	sort.Strings(cmds)
+	stats := make([]p4CommandStats, len(cmds))
+	for i, cmd := range cmds {
+		stats[i] = r.commands[cmd].clone()
+	}
+
+	keys := make([]p4TableKey, 0, len(r.tables))
+	for k := range r.tables {
+		keys = append(keys, k)
+	}
+	sort.Slice(keys, func(i, j int) bool {
+		if keys[i].cmd != keys[j].cmd {
+			return keys[i].cmd < keys[j].cmd
+		}
+		return keys[i].table < keys[j].table
+	})
+	tables := make([]p4TableStats, len(keys))
+	for i, k := range keys {
+		tables[i] = *r.tables[k]
+	}
+
+	names := make([]string, 0, len(r.pools))
+	for name := range r.pools {
+		names = append(names, name)
+	}
+	sort.Strings(names)
+	pools := make([]*P4Pool, len(names))
+	for i, name := range names {
+		pools[i] = r.pools[name]
+	}
+	r.mu.Unlock()
+
+	mw.family("p4go_command_duration_seconds", "histogram", "seconds",
+		"Time taken by runs, from start to the end of the output.")
+	for i, cmd := range cmds {
+		mw.histogram("p4go_command_duration_seconds", cmd, r.buckets, &stats[i].duration)
+	}
+	mw.family("p4go_command_first_record_seconds", "histogram", "seconds",
+		"Time from the start of a run to its first output.")
+	for i, cmd := range cmds {
+		mw.histogram("p4go_command_first_record_seconds", cmd, r.buckets, &stats[i].firstRecord)
+	}
+	mw.family("p4go_command_records", "counter", "",
+		"Output received, by result type.")
+	for i, cmd := range cmds {
+		for t, n := range stats[i].records {
+			mw.sample("p4go_command_records_total", n, "cmd", cmd, "type", p4ResultTypeNames[t])
+		}
+	}
+	mw.family("p4go_command_output_bytes", "counter", "bytes",
+		"Bytes of text and binary output received.")
+	for i, cmd := range cmds {
+		c := &stats[i]
+		mw.sample("p4go_command_output_bytes_total", c.textBytes, "cmd", cmd, "kind", "text")
+		mw.sample("p4go_command_output_bytes_total", c.binaryBytes, "cmd", cmd, "kind", "binary")
+	}
+	mw.family("p4go_command_handler_seconds", "counter", "seconds",
+		"Time spent in handlers, streams and other callbacks into Go.")
+	for i, cmd := range cmds {
+		mw.sample("p4go_command_handler_seconds_total", stats[i].handler.Seconds(), "cmd", cmd)
+	}
+	mw.family("p4go_command_callbacks", "counter", "",
+		"Calls from the C++ side of the binding into Go.")
+	for i, cmd := range cmds {
+		mw.sample("p4go_command_callbacks_total", stats[i].crossings, "cmd", cmd)
+	}
+	mw.family("p4go_reconnects", "counter", "",
+		"Connections made again after being dropped, by the command being run.")
+	for i, cmd := range cmds {
+		mw.sample("p4go_reconnects_total", stats[i].reconnects, "cmd", cmd)
+	}
+
+	mw.family("p4go_track_lock_wait_seconds", "counter", "seconds",
+		"Time spent waiting for table locks, from track output.")
+	for i, k := range keys {
+		t := &tables[i]
+		mw.sample("p4go_track_lock_wait_seconds_total", t.readWait.Seconds(), "cmd", k.cmd, "table", k.table, "mode", "read")
+		mw.sample("p4go_track_lock_wait_seconds_total", t.writeWait.Seconds(), "cmd", k.cmd, "table", k.table, "mode", "write")
+	}
+	mw.family("p4go_track_lock_held_seconds", "counter", "seconds",
+		"Time table locks were held, from track output.")
+	for i, k := range keys {
+		t := &tables[i]
+		mw.sample("p4go_track_lock_held_seconds_total", t.readHeld.Seconds(), "cmd", k.cmd, "table", k.table, "mode", "read")
+		mw.sample("p4go_track_lock_held_seconds_total", t.writeHeld.Seconds(), "cmd", k.cmd, "table", k.table, "mode", "write")
+	}
+	mw.family("p4go_track_lock_held_max_seconds", "gauge", "seconds",
+		"Longest a single command held a table lock, from track output.")
+	for i, k := range keys {
+		t := &tables[i]
+		mw.sample("p4go_track_lock_held_max_seconds", t.maxReadHeld.Seconds(), "cmd", k.cmd, "table", k.table, "mode", "read")
+		mw.sample("p4go_track_lock_held_max_seconds", t.maxWriteHeld.Seconds(), "cmd", k.cmd, "table", k.table, "mode", "write")
+	}
+	mw.family("p4go_track_lock_wait_max_seconds", "gauge", "seconds",
+		"Longest a single command waited for a table lock, from track output.")
+	for i, k := range keys {
+		t := &tables[i]
+		mw.sample("p4go_track_lock_wait_max_seconds", t.maxReadWait.Seconds(), "cmd", k.cmd, "table", k.table, "mode", "read")
+		mw.sample("p4go_track_lock_wait_max_seconds", t.maxWriteWait.Seconds(), "cmd", k.cmd, "table", k.table, "mode", "write")
+	}
+	mw.family("p4go_track_scan_rows", "counter", "",
+		"Table rows scanned, from track output.")
+	for i, k := range keys {
+		mw.sample("p4go_track_scan_rows_total", tables[i].scanRows, "cmd", k.cmd, "table", k.table)
+	}
+
+	// The pools have locks of their own
+	mw.family("p4go_pool_connections", "gauge", "",
+		"Connections held by a pool, in use and idle.")
+	for i, name := range names {
+		mw.sample("p4go_pool_connections", pools[i].InUse(), "pool", name, "state", "in_use")
+		mw.sample("p4go_pool_connections", pools[i].Idle(), "pool", name, "state", "idle")
+	}
+	mw.family("p4go_pool_size", "gauge", "",
+		"Most connections a pool has open at once.")
+	for i, name := range names {
+		mw.sample("p4go_pool_size", pools[i].Size(), "pool", name)
+	}
+
+	cw.WriteString("# EOF\n")
+	if cw.err == nil {
+		cw.err = cw.w.Flush()
+	}
+	return cw.n, cw.err
+}
+
+// p4CountingWriter keeps the first error and the count that WriteTo
+// returns, so that the writing itself needn't check every call.
+type p4CountingWriter struct {
+	w   *bufio.Writer
+	n   int64
+	err error
+}
+
+func (cw *p4CountingWriter) WriteString(s string) {
+	if cw.err != nil {
+		return
+	}
+	n, err := cw.w.WriteString(s)
+	cw.n += int64(n)
+	cw.err = err
+}
+
+type p4MetricsWriter struct {
+	w *p4CountingWriter
+}
+
+func (mw *p4MetricsWriter) family(name, kind, unit, help string) {
+	mw.w.WriteString("# TYPE " + name + " " + kind + "\n")
+	if unit != "" {
+		mw.w.WriteString("# UNIT " + name + " " + unit + "\n")
+	}
+	mw.w.WriteString("# HELP " + name + " " + help + "\n")
+}
+
+func (mw *p4MetricsWriter) histogram(name, cmd string, buckets []float64, h *p4Histogram) {
+	var n int64
+	for i, b := range buckets {
+		n += h.counts[i]
+		mw.sample(name+"_bucket", n, "cmd", cmd, "le", p4MetricValue(b))
+	}
+	mw.sample(name+"_bucket", h.count, "cmd", cmd, "le", "+Inf")
+	mw.sample(name+"_sum", h.sum, "cmd", cmd)
+	mw.sample(name+"_count", h.count, "cmd", cmd)
+}
+
+// sample writes one sample, labelled by the name and value pairs in labels
+func (mw *p4MetricsWriter) sample(name string, value any, labels ...string) {
+	var b strings.Builder
+	b.WriteString(name)
+	for i := 0; i+1 < len(labels); i += 2 {
+		if i == 0 {
+			b.WriteByte('{')
+		} else {
+			b.WriteByte(',')
+		}
+		b.WriteString(labels[i])
+		b.WriteString(`="`)
+		b.WriteString(p4MetricsEscaper.Replace(labels[i+1]))
+		b.WriteByte('"')
+	}
+	if len(labels) > 0 {
+		b.WriteByte('}')
+	}
+	b.WriteByte(' ')
+	b.WriteString(p4MetricValue(value))
+	b.WriteByte('\n')
+	mw.w.WriteString(b.String())
+}
+
+var p4MetricsEscaper = strings.NewReplacer(`\`, `\\`, `"`, `\"`, "\n", `\n`)
+
+func p4MetricValue(v any) string {
+	switch v := v.(type) {
+	case int:
+		return strconv.Itoa(v)
+	case int64:
+		return strconv.FormatInt(v, 10)
+	case float64:
+		if math.IsInf(v, 1) {
+			return "+Inf"
+		}
+		return strconv.FormatFloat(v, 'g', -1, 64)
+	}
+	return fmt.Sprint(v)
+}
@@ -0,0 +1,256 @@
+/*******************************************************************************
+
+Copyright (c) 2024, Perforce Software, Inc.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+package p4
+
+import (
+	"context"
+	"errors"
+	"sync"
+	"time"
+)
+
+// P4PoolConfig describes the connections a P4Pool makes. Port, User and
+// Client are applied to each new connection when set; anything else can
+// be done in Setup, which runs before the connection is opened.
+type P4PoolConfig struct {
+	Port     string
+	User     string
+	Client   string
+	Password string
+	Prog     string
+
+	// Size is the most connections the pool has open at once, in use and
+	// idle together. Warm of them are opened by NewPool.
+	Size int
+	Warm int
+
+	// MaxIdle, if set, retires connections that have sat idle for longer,
+	// before the server's idle timeout can drop them unnoticed.
+	MaxIdle time.Duration
+
+	Setup func(p4 *P4) error
+}
+
+// P4Pool keeps connected P4 instances for one port, user and client, and
+// hands them out to goroutines. Connections are checked before they are
+// handed out and when they come back, and broken ones are replaced, so
+// callers only pay for a connect when the pool has nothing idle to give.
+type P4Pool struct {
+	config P4PoolConfig
+	slots  chan struct{} // a token for each connection in use
+
+	mu     sync.Mutex
+	idle   []p4PoolIdle // most recently returned last
+	closed bool
+}
+
+type p4PoolIdle struct {
+	p4    *P4
+	since time.Time
+}
+
+var ErrPoolClosed = errors.New("p4: pool is closed")
+
+// NewPool makes a pool, opening config.Warm connections straight away.
+func NewPool(config P4PoolConfig) (*P4Pool, error) {
+	if config.Size <= 0 {
+		return nil, errors.New("p4: pool size must be positive")
+	}
+	if config.Warm > config.Size {
+		config.Warm = config.Size
+	}
+	pool := &P4Pool{config: config, slots: make(chan struct{}, config.Size)}
+	for i := 0; i < config.Warm; i++ {
+		p4, err := pool.open()
+		if err != nil {
+			pool.Close()
+			return nil, err
+		}
+		pool.idle = append(pool.idle, p4PoolIdle{p4, time.Now()})
+	}
+	return pool, nil
+}
+
+// Get returns a connected P4, waiting for one to be free if the pool is at
+// its size. It gives up when ctx is done. The P4 must be given back with
+// Put, and should be given back as it was found: any handlers or settings
+// changed while it was out stay with it.
+func (pool *P4Pool) Get(ctx context.Context) (*P4, error) {
+	select {
+	case pool.slots <- struct{}{}:
+	case <-ctx.Done():
+		return nil, ctx.Err()
+	}
+
+	for {
+		p4, err := pool.takeIdle()
+		if err != nil {
+			<-pool.slots
+			return nil, err
+		}
+		if p4 == nil {
+			break
+		}
+		if p4.Connected() {
+			return p4, nil
+		}
+		pool.discard(p4)
+	}
+
+	p4, err := pool.open()
+	if err != nil {
+		<-pool.slots
+		return nil, err
+	}
+	return p4, nil
+}
+
+// Put gives a P4 back to the pool. Broken connections, and any that come
+// back after the pool is closed, are closed rather than kept.
+func (pool *P4Pool) Put(p4 *P4) {
+	defer func() { <-pool.slots }()
+
+	if !p4.Connected() {
+		pool.discard(p4)
+		return
+	}
+
+	pool.mu.Lock()
+	if pool.closed {
+		pool.mu.Unlock()
+		pool.discard(p4)
+		return
+	}
+	pool.idle = append(pool.idle, p4PoolIdle{p4, time.Now()})
+	pool.mu.Unlock()
+}
+
+// Idle is the number of connections waiting to be handed out
+func (pool *P4Pool) Idle() int {
+	pool.mu.Lock()
+	defer pool.mu.Unlock()
+	return len(pool.idle)
+}
+
+// InUse is the number of connections handed out and not yet put back
+func (pool *P4Pool) InUse() int {
+	return len(pool.slots)
+}
+
+// Size is the most connections the pool has open at once
+func (pool *P4Pool) Size() int {
+	return pool.config.Size
+}
+
+// Close closes the idle connections and stops the pool handing out any
+// more. Connections still out are closed as they are put back.
+func (pool *P4Pool) Close() {
+	pool.mu.Lock()
+	idle := pool.idle
+	pool.idle = nil
+	pool.closed = true
+	pool.mu.Unlock()
+
+	for _, c := range idle {
+		pool.discard(c.p4)
+	}
+}
+
+// takeIdle pops the most recently used idle connection, retiring any
+// that have been idle too long. It returns nil if there are none.
+func (pool *P4Pool) takeIdle() (*P4, error) {
+	pool.mu.Lock()
+	if pool.closed {
+		pool.mu.Unlock()
+		return nil, ErrPoolClosed
+	}
+
+	var stale []*P4
+	if pool.config.MaxIdle > 0 {
+		cutoff := time.Now().Add(-pool.config.MaxIdle)
+		keep := pool.idle[:0]
+		for _, c := range pool.idle {
+			if c.since.Before(cutoff) {
+				stale = append(stale, c.p4)
+			} else {
+				keep = append(keep, c)
+			}
+		}
+		pool.idle = keep
+	}
+
+	var p4 *P4
+	if n := len(pool.idle); n > 0 {
+		p4 = pool.idle[n-1].p4
+		pool.idle = pool.idle[:n-1]
+	}
+	pool.mu.Unlock()
+
+	for _, s := range stale {
+		pool.discard(s)
+	}
+	return p4, nil
+}
+
+func (pool *P4Pool) open() (*P4, error) {
+	p4 := New()
+	c := &pool.config
+	if c.Port != "" {
+		p4.SetPort(c.Port)
+	}
+	if c.User != "" {
+		p4.SetUser(c.User)
+	}
+	if c.Client != "" {
+		p4.SetClient(c.Client)
+	}
+	if c.Password != "" {
+		p4.SetPassword(c.Password)
+	}
+	if c.Prog != "" {
+		p4.SetProg(c.Prog)
+	}
+	if c.Setup != nil {
+		if err := c.Setup(p4); err != nil {
+			p4.Close()
+			return nil, err
+		}
+	}
+	if _, err := p4.Connect(); err != nil {
+		p4.Close()
+		return nil, err
+	}
+	return p4, nil
+}
+
+func (pool *P4Pool) discard(p4 *P4) {
+	if p4.Connected() {
+		_, _ = p4.Disconnect()
+	}
+	p4.Close()
+}
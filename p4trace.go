@@ -0,0 +1,127 @@
+/*******************************************************************************
+
+Copyright (c) 2024, Perforce Software, Inc.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+package p4
+
+import (
+	"errors"
+	"fmt"
+	"io"
+	"time"
+)
+
+// P4TraceEventType is what happened in a P4TraceEvent. The values match
+// P4GoTraceType in p4gotrace.h.
+type P4TraceEventType int
+
+const (
+	P4TRACE_RUN    P4TraceEventType = iota // Size: arguments
+	P4TRACE_END                            // Size: results
+	P4TRACE_TEXT                           // Size: bytes
+	P4TRACE_BINARY                         // Size: bytes
+	P4TRACE_STAT
+	P4TRACE_SPEC
+	P4TRACE_TRACK   // Size: lines
+	P4TRACE_MESSAGE // Arg: severity
+	P4TRACE_ERROR   // Arg: severity
+	P4TRACE_FILTERED
+	P4TRACE_HANDLER // Arg: what the handler returned
+	P4TRACE_FLUSH   // Arg: what the stream returned; Size: results
+	P4TRACE_INPUT   // Size: bytes
+	P4TRACE_PROMPT
+	P4TRACE_RESOLVE // Arg: 1 for an action resolve
+	P4TRACE_DIFF
+	P4TRACE_PROGRESS // Arg: progress type
+	P4TRACE_CONNECT  // Arg: 1 if it succeeded
+	P4TRACE_DISCONNECT
+	P4TRACE_RECONNECT // Arg: attempt; Size: delay in ms
+	P4TRACE_TRANSFER  // Arg: threads
+	P4TRACE_CHARSET
+)
+
+var p4TraceEventNames = []string{
+	"run", "end", "text", "binary", "stat", "spec", "track", "message",
+	"error", "filtered", "handler", "flush", "input", "prompt", "resolve",
+	"diff", "progress", "connect", "disconnect", "reconnect", "transfer",
+	"charset",
+}
+
+func (t P4TraceEventType) String() string {
+	if t >= 0 && int(t) < len(p4TraceEventNames) {
+		return p4TraceEventNames[t]
+	}
+	return fmt.Sprintf("event(%d)", int(t))
+}
+
+// P4TraceEvent is one event from the trace ring (see SetTrace). What Arg
+// and Size hold depends on the Type.
+type P4TraceEvent struct {
+	Time time.Time
+	Type P4TraceEventType
+	Arg  int
+	Size int64
+	Cmd  string // the command being run, cut to 24 bytes
+}
+
+func (e P4TraceEvent) String() string {
+	return fmt.Sprintf("%s [P4] %s %s arg=%d size=%d",
+		e.Time.Format("2006-01-02T15:04:05.000000Z07:00"), e.Cmd, e.Type,
+		e.Arg, e.Size)
+}
+
+// DumpTrace writes the events in the trace ring to w, oldest first, one
+// to a line. The ring is left as it is.
+func (p4 *P4) DumpTrace(w io.Writer) error {
+	for _, e := range p4.Trace() {
+		if _, err := fmt.Fprintln(w, e); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+// SetTraceDumpOnError has this P4 write its trace ring to w, with
+// DumpTrace, whenever a command fails, and then clear it so that the
+// next dump starts afresh. A nil w stops it. Tracing must be on too; see
+// SetTrace.
+func (p4 *P4) SetTraceDumpOnError(w io.Writer) {
+	p4.traceDump = w
+}
+
+// dumpTrace dumps the ring after a failed run, if asked to, and returns
+// the run's error with any failure to write the dump joined on. The ring
+// is only cleared once it has been written out.
+func (p4 *P4) dumpTrace(err error) error {
+	if err == nil || p4.traceDump == nil {
+		return err
+	}
+	if dumpErr := p4.DumpTrace(p4.traceDump); dumpErr != nil {
+		return errors.Join(err, fmt.Errorf("dumping trace: %w", dumpErr))
+	}
+	p4.ClearTrace()
+	return err
+}